@@ -0,0 +1,103 @@
+/**
+ * @file arena.h
+ * @brief This file contains the Arena class, a bump allocator for the short
+ * lived objects of one request, freed all at once with the request
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bytes held inside the arena itself, enough for the filters of most requests
+#define ARENA_INLINE_SIZE 4096
+
+// Minimum size of a block allocated once the inline bytes run out
+#define ARENA_BLOCK_SIZE 16384
+
+/**
+ * @struct ArenaArray
+ * @brief Fixed size array allocated in an arena, it owns nothing
+ */
+template <typename T> struct ArenaArray {
+  T *first = nullptr;
+  size_t count = 0;
+
+  T &operator[](size_t i) { return first[i]; }
+  const T &operator[](size_t i) const { return first[i]; }
+  T *begin() { return first; }
+  T *end() { return first + count; }
+  const T *begin() const { return first; }
+  const T *end() const { return first + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+};
+
+/**
+ * @class Arena
+ * @brief Hands out memory by bumping a pointer, first from bytes held inline
+ * and then from heap blocks, nothing is freed before the arena is destroyed
+ * and no destructors are run, so only trivially destructible types fit
+ */
+class Arena {
+public:
+  Arena() {}
+  virtual ~Arena() {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * @brief Allocate default constructed values
+   * @param count The number of values
+   * @return The values, valid until the arena is destroyed
+   */
+  template <typename T> ArenaArray<T> allocate(size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "Arena values are never destroyed");
+
+    ArenaArray<T> array;
+    if (count == 0) {
+      return array;
+    }
+
+    array.first =
+        static_cast<T *>(allocateBytes(count * sizeof(T), alignof(T)));
+    array.count = count;
+    for (size_t i = 0; i < count; ++i) {
+      new (array.first + i) T();
+    }
+    return array;
+  }
+
+private:
+  /**
+   * @brief Allocate raw bytes
+   * @param size The number of bytes
+   * @param alignment The alignment of the bytes
+   */
+  void *allocateBytes(size_t size, size_t alignment);
+
+  /**
+   * @brief The bytes used before any block is allocated
+   */
+  alignas(std::max_align_t) unsigned char inlineBytes[ARENA_INLINE_SIZE];
+  /**
+   * @brief The heap blocks
+   */
+  std::vector<std::unique_ptr<unsigned char[]>> blocks;
+  /**
+   * @brief The first free byte
+   */
+  unsigned char *current = inlineBytes;
+  /**
+   * @brief Number of free bytes after current
+   */
+  size_t remaining = ARENA_INLINE_SIZE;
+};
+
+#endif
@@ -1,22 +1,29 @@
 /**
  * @file ber.h
- * @brief This file contains the BERParser class
+ * @brief This file contains the BERParser and BEREncoder classes
  * @author Simon Bencik <xbenci01>
  */
 #ifndef BER_H
 #define BER_H
 
 #include "../include/search.h"
+#include <cstdint>
 #include <iostream>
+#include <string_view>
 #include <vector>
 
+// Filters nested deeper are rejected, they are parsed and searched
+// recursively and would overflow the stack
+#define MAX_FILTER_DEPTH 256
+
 /**
  * @class BERParser
- * @brief Parses BER encoded data
+ * @brief Parses BER encoded data, the strings it returns point into the
+ * parsed buffer, which has to outlive them
  */
 class BERParser {
 public:
-  BERParser(std::vector<unsigned char> &buffer);
+  BERParser(std::string_view buffer);
   virtual ~BERParser(){};
 
   /**
@@ -29,13 +36,13 @@ public:
    * @brief Get the length from the buffer
    * @param length The length to be returned
    */
-  bool getLength(unsigned char &length);
+  bool getLength(size_t &length);
 
   /**
-   * @brief Get the integer from the buffer
+   * @brief Get the integer from the buffer, up to 32 bits
    * @param integer The integer to be returned
    */
-  bool getInteger(unsigned char &integer);
+  bool getInteger(int32_t &integer);
 
   /**
    * @brief Get the boolean from the buffer
@@ -44,34 +51,41 @@ public:
   bool getBool(unsigned char &boolean);
 
   /**
-   * @brief Get the enumeration from the buffer
+   * @brief Get the enumeration from the buffer, up to 32 bits
    * @param enumeration The enumeration to be returned
    */
-  bool getEnum(unsigned char &enumeration);
+  bool getEnum(int32_t &enumeration);
 
   /**
    * @brief Get the octet string from the buffer
    * @param octetString The octet string to be returned
    */
-  bool getOctetString(std::vector<unsigned char> &octetString);
+  bool getOctetString(std::string_view &octetString);
 
   /**
-   * @brief Get the sequence from the buffer
-   * @param sequence The sequence to be returned
+   * @brief Get the sequence from the buffer, the parser moves to its first
+   * element
+   * @param sequence The contents of the sequence to be returned
    */
-  bool getSequence(std::vector<unsigned char> &sequence);
+  bool getSequence(std::string_view &sequence);
 
   /**
    * @brief Get the substring filter from the buffer
+   * @param sequence The sequence of substrings, the parser is at its start
    * @param subsMatch The substring filter to be returned
+   * @param arena The arena to allocate the any substrings in
    */
-  bool getSubstringFilter(SubsType &subsMatch);
+  bool getSubstringFilter(std::string_view sequence, SubsType &subsMatch,
+                          Arena &arena);
 
   /**
-   * @brief Get the filter from the buffer
+   * @brief Get the filter from the buffer, filters nested more than
+   * MAX_FILTER_DEPTH levels deep are invalid
    * @param filter The filter to be returned
+   * @param arena The arena to allocate the nested filters in
+   * @param depth Number of filters the filter is nested in
    */
-  bool getFilter(Filter &filter);
+  bool getFilter(Filter &filter, Arena &arena, size_t depth = 0);
 
   /**
    * @brief Check if the end of the buffer has been reached
@@ -82,7 +96,105 @@ private:
   /**
    * @brief The buffer to be parsed
    */
-  std::vector<unsigned char> &buffer;
+  std::string_view buffer;
+
+  /**
+   * @brief The current position in the buffer
+   */
+  size_t pos;
+
+  /**
+   * @brief Get an integer encoded value, INTEGER or ENUMERATED
+   * @param expectedTag The tag the value must have
+   * @param value The value to be returned
+   */
+  bool getIntegerValue(unsigned char expectedTag, int32_t &value);
+
+  /**
+   * @brief Check that the buffer holds more bytes after the position
+   * @param count The number of bytes
+   */
+  bool hasBytes(size_t count);
+
+  /**
+   * @brief Count the elements from the position to the end without moving
+   * @param end The position after the last element
+   * @param count The number of elements to be returned
+   */
+  bool countElements(size_t end, size_t &count);
+};
+
+/**
+ * @class BEREncoder
+ * @brief Encodes BER data into a buffer of the exact size, the sizes are
+ * computed first with the static functions, so nothing grows while encoding
+ */
+class BEREncoder {
+public:
+  /**
+   * @brief Create the encoder
+   * @param buffer The buffer to write to, large enough for everything encoded
+   */
+  BEREncoder(unsigned char *buffer) : buffer(buffer), pos(0) {}
+  virtual ~BEREncoder() {}
+
+  /**
+   * @brief Get the number of bytes a length takes, long form above 127
+   * @param length The length to encode
+   */
+  static size_t lengthSize(size_t length);
+
+  /**
+   * @brief Get the number of bytes a whole TLV takes
+   * @param contentSize The size of its content
+   */
+  static size_t tlvSize(size_t contentSize) {
+    return 1 + lengthSize(contentSize) + contentSize;
+  }
+
+  /**
+   * @brief Get the number of content bytes of an integer
+   * @param value The integer to encode
+   */
+  static size_t integerSize(int64_t value);
+
+  /**
+   * @brief Put a tag and the length of its content
+   * @param tag The tag
+   * @param length The size of the content which follows
+   */
+  void putHeader(unsigned char tag, size_t length);
+
+  /**
+   * @brief Put an integer, in the fewest two's complement bytes
+   * @param value The integer
+   * @param tag The tag, INTEGER unless it is an ENUMERATED
+   */
+  void putInteger(int64_t value, unsigned char tag = 0x02);
+
+  /**
+   * @brief Put an octet string
+   * @param value The string
+   */
+  void putOctetString(std::string_view value);
+
+  /**
+   * @brief Put bytes encoded elsewhere
+   * @param data The bytes
+   * @param size The number of bytes
+   */
+  void putBytes(const void *data, size_t size);
+
+  /**
+   * @brief Get the number of bytes written so far
+   */
+  size_t size() const { return pos; }
+
+private:
+  /**
+   * @brief The buffer to write to
+   */
+  unsigned char *buffer;
 
   /**
    * @brief The current position in the buffer
@@ -0,0 +1,215 @@
+/**
+ * @file bitmap.h
+ * @brief This file contains the Bitmap class, a compressed set of entry ids
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define CONTAINER_BITS 65536
+#define MAX_ARRAY_SIZE 4096
+
+/**
+ * @class Bitmap
+ * @brief Roaring style set of 32-bit ids, split by the high 16 bits into
+ * containers which are sorted arrays when sparse and plain bitmaps when
+ * dense
+ */
+class Bitmap {
+public:
+  Bitmap() {}
+  virtual ~Bitmap() {}
+
+  /**
+   * @brief Create a bitmap from ascending ids
+   * @param first The first id
+   * @param last Past the last id
+   * @return The bitmap
+   */
+  static Bitmap fromSorted(const uint32_t *first, const uint32_t *last);
+
+  /**
+   * @brief Create a bitmap holding every id below the size
+   * @param size The number of ids
+   * @return The bitmap
+   */
+  static Bitmap range(uint32_t size);
+
+  /**
+   * @brief Add an id greater than every id in the bitmap
+   * @param id The id to add
+   */
+  void append(uint32_t id);
+
+  /**
+   * @brief Get the number of ids in the bitmap
+   */
+  size_t cardinality() const;
+
+  /**
+   * @brief Check whether the bitmap holds no ids
+   */
+  bool empty() const { return containers.empty(); }
+
+  /**
+   * @brief Intersection of two bitmaps
+   */
+  Bitmap operator&(const Bitmap &other) const;
+
+  /**
+   * @brief Union of two bitmaps
+   */
+  Bitmap operator|(const Bitmap &other) const;
+
+  /**
+   * @brief Ids of this bitmap not present in the other one
+   */
+  Bitmap operator-(const Bitmap &other) const;
+
+  /**
+   * @brief Check whether the bitmap holds the id
+   * @param id The id to look for
+   */
+  bool contains(uint32_t id) const;
+
+  /**
+   * @brief Call the function for every id in ascending order until it
+   * returns false
+   * @param function The function to call
+   * @return Whether every id was visited
+   */
+  template <typename Function> bool forEach(Function function) const {
+    for (size_t i = 0; i < containers.size(); ++i) {
+      if (!forEachInContainer(i, function)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Call the function for every id from the given one on in
+   * ascending order until it returns false
+   * @param from The first id to visit if present
+   * @param function The function to call
+   * @return Whether every id was visited
+   */
+  template <typename Function>
+  bool forEachFrom(uint32_t from, Function function) const {
+    uint16_t key = static_cast<uint16_t>(from >> 16);
+    for (size_t i = 0; i < containers.size(); ++i) {
+      if (containers[i].key < key) {
+        continue;
+      }
+
+      uint16_t low = containers[i].key == key ? from & 0xFFFF : 0;
+      if (!forEachInContainer(i, function, low)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Get the number of containers, each holds a range of 65536 ids
+   */
+  size_t containerCount() const { return containers.size(); }
+
+  /**
+   * @brief Call the function for every id of one container in ascending
+   * order until it returns false
+   * @param index The index of the container
+   * @param function The function to call
+   * @param from The low 16 bits of the first id to visit
+   * @return Whether every id was visited
+   */
+  template <typename Function>
+  bool forEachInContainer(size_t index, Function function,
+                          uint16_t from = 0) const {
+    const Container &container = containers[index];
+    uint32_t high = static_cast<uint32_t>(container.key) << 16;
+
+    if (container.words.empty()) {
+      auto start = std::lower_bound(container.values.begin(),
+                                    container.values.end(), from);
+      for (auto low = start; low != container.values.end(); ++low) {
+        if (!function(high | *low)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    for (size_t i = from / 64; i < container.words.size(); ++i) {
+      uint64_t word = container.words[i];
+      if (i == from / 64) {
+        word &= ~0ULL << (from % 64);
+      }
+      while (word) {
+        if (!function(high | (i * 64 + __builtin_ctzll(word)))) {
+          return false;
+        }
+        word &= word - 1;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  /**
+   * @struct Container
+   * @brief Ids sharing the high 16 bits, either values or words is used
+   */
+  struct Container {
+    uint16_t key;
+    uint32_t cardinality;
+    std::vector<uint16_t> values;
+    std::vector<uint64_t> words;
+  };
+
+  /**
+   * @brief The containers, ordered by key
+   */
+  std::vector<Container> containers;
+
+  /**
+   * @enum Operation
+   * @brief The set operation to combine two containers with
+   */
+  enum class Operation {
+    And,
+    Or,
+    AndNot,
+  };
+
+  /**
+   * @brief Combine two bitmaps container by container
+   */
+  Bitmap combine(const Bitmap &other, Operation operation) const;
+
+  /**
+   * @brief Combine two containers with the same key
+   * @return Whether the result holds any ids
+   */
+  static bool combineContainers(const Container &a, const Container &b,
+                                Operation operation, Container &result);
+
+  /**
+   * @brief Get the container as bitmap words
+   */
+  static std::vector<uint64_t> toWords(const Container &container);
+
+  /**
+   * @brief Store the words in the container, as an array if it is sparse
+   */
+  static void fromWords(std::vector<uint64_t> &&words, Container &container);
+};
+
+#endif
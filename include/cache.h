@@ -0,0 +1,321 @@
+/**
+ * @file cache.h
+ * @brief This file contains the ResultCache class, which keeps the ids of
+ * the entries matched by recent searches and shares them between identical
+ * searches running at the same time
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "../include/search.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Searches are spread over shards so they rarely wait for the same lock
+#define RESULT_CACHE_SHARDS 16
+
+// Default number of bytes the cached results may take
+#define RESULT_CACHE_SIZE (64 << 20)
+
+/**
+ * @struct CachedResult
+ * @brief The ids of the entries a search sends, in file order
+ */
+struct CachedResult {
+  std::vector<uint32_t> ids;
+  bool sizeLimitReached = false;
+};
+
+/**
+ * @class SearchFlight
+ * @brief The result of a search being computed, published in chunks so the
+ * identical searches reading it send entries while it runs
+ */
+class SearchFlight {
+public:
+  /**
+   * @enum State
+   * @brief How far the search publishing the result got
+   */
+  enum class State { Running, Done, Abandoned };
+
+  /**
+   * @brief Create the flight
+   * @param version The version of the directory being searched
+   */
+  explicit SearchFlight(uint64_t version);
+  virtual ~SearchFlight() {}
+
+  SearchFlight(const SearchFlight &) = delete;
+  SearchFlight &operator=(const SearchFlight &) = delete;
+
+  /**
+   * @brief Append the next ids of the result and wake the readers
+   * @param ids The ids in file order
+   */
+  void publish(const std::vector<uint32_t> &ids);
+
+  /**
+   * @brief Mark the result complete and wake the readers
+   * @param sizeLimitReached Whether the search stopped at its size limit
+   */
+  void finish(bool sizeLimitReached);
+
+  /**
+   * @brief Mark the result incomplete for good and wake the readers, they
+   * compute the rest themselves
+   */
+  void abandon();
+
+  /**
+   * @brief Count a search which reads the result
+   */
+  void join();
+
+  /**
+   * @brief Wait for ids past the ones already read, or for the search to end
+   * @param from Number of ids already read
+   * @param chunk The ids published after them, to be returned
+   * @param sizeLimitReached Whether the search stopped at its size limit, to
+   * be returned once it is done
+   * @return The state after the returned ids
+   */
+  State read(size_t from, std::vector<uint32_t> &chunk,
+             bool &sizeLimitReached);
+
+  /**
+   * @brief Get the version of the directory being searched
+   */
+  uint64_t getVersion() const { return version; }
+
+  /**
+   * @brief Get the number of ids published so far
+   */
+  size_t size();
+
+  /**
+   * @brief Get the number of searches which joined the flight
+   */
+  size_t readers();
+
+  /**
+   * @brief Get the result, complete once the flight is done
+   */
+  std::shared_ptr<const CachedResult> getResult() const { return result; }
+
+private:
+  /**
+   * @brief The version of the directory being searched
+   */
+  uint64_t version;
+  /**
+   * @brief Guards everything below
+   */
+  std::mutex mutex;
+  /**
+   * @brief Signalled when ids are published or the flight ends
+   */
+  std::condition_variable changed;
+  /**
+   * @brief The ids published so far
+   */
+  std::shared_ptr<CachedResult> result;
+  /**
+   * @brief How far the search got
+   */
+  State state = State::Running;
+  /**
+   * @brief Number of searches which joined
+   */
+  size_t readerCount = 0;
+};
+
+/**
+ * @struct CacheLookup
+ * @brief What a search found in the cache, the cached result, a flight of
+ * the same search to read, or a new flight the search leads and completes
+ */
+struct CacheLookup {
+  std::shared_ptr<const CachedResult> result;
+  std::shared_ptr<SearchFlight> flight;
+  bool leading = false;
+};
+
+/**
+ * @class ResultCache
+ * @brief Bounded LRU cache of search results, keyed by the canonical form of
+ * the filter and the size limit, results of an older directory version are
+ * dropped once a newer one is seen, a search whose result is being computed
+ * by another one reads it as it is published instead of computing it again
+ */
+class ResultCache {
+public:
+  /**
+   * @brief Create the cache
+   * @param capacity Number of bytes the cached results may take, nothing is
+   * cached or shared when it is zero
+   */
+  explicit ResultCache(size_t capacity);
+  virtual ~ResultCache() {}
+
+  ResultCache(const ResultCache &) = delete;
+  ResultCache &operator=(const ResultCache &) = delete;
+
+  /**
+   * @brief Build the key of a search, the children of AND and OR filters are
+   * sorted so their order does not matter
+   * @param filter The case folded filter
+   * @param sizeLimit The size limit, all values without a limit are the same
+   * @param key The key to be returned
+   */
+  static void makeKey(const Filter &filter, int32_t sizeLimit,
+                      std::string &key);
+
+  /**
+   * @brief Check whether results are cached at all
+   */
+  bool enabled() const { return shardCapacity > 0; }
+
+  /**
+   * @brief Check whether a result of the given number of ids can be cached
+   * @param count The number of ids
+   */
+  bool fits(size_t count) const;
+
+  /**
+   * @brief Look up the result of a search, counted as a hit, a miss or a
+   * shared search, never waits
+   * @param key The key of the search
+   * @param version The version of the directory being searched
+   * @return The cached result, or the flight of the same search running on
+   * the same version, joined already, or a new flight the caller leads and
+   * passes to complete or abandon, or nothing when the caller runs the
+   * search on its own
+   */
+  CacheLookup find(const std::string &key, uint64_t version);
+
+  /**
+   * @brief Finish the flight of a search and add its result to the cache,
+   * the least recently used results are dropped to make room
+   * @param key The key of the search
+   * @param flight The flight led by the caller
+   * @param sizeLimitReached Whether the search stopped at its size limit
+   */
+  void complete(const std::string &key,
+                const std::shared_ptr<SearchFlight> &flight,
+                bool sizeLimitReached);
+
+  /**
+   * @brief Abandon the flight of a search which failed, its readers compute
+   * the rest of the result themselves
+   * @param key The key of the search
+   * @param flight The flight led by the caller
+   */
+  void abandon(const std::string &key,
+               const std::shared_ptr<SearchFlight> &flight);
+
+  /**
+   * @brief Stop sharing a search whose result grew too big to be cached,
+   * unless another search reads it already
+   * @param key The key of the search
+   * @param flight The flight led by the caller
+   * @return Whether the flight was abandoned, the caller stops publishing
+   */
+  bool release(const std::string &key,
+               const std::shared_ptr<SearchFlight> &flight);
+
+  /**
+   * @brief Get the number of searches answered from the cache
+   */
+  uint64_t hits() const { return hitCount.load(); }
+
+  /**
+   * @brief Get the number of searches not found in the cache
+   */
+  uint64_t misses() const { return missCount.load(); }
+
+  /**
+   * @brief Get the number of searches which read the result of the same
+   * search running at the same time, they are not counted as hits or misses
+   */
+  uint64_t shared() const { return sharedCount.load(); }
+
+private:
+  /**
+   * @struct Entry
+   * @brief A cached result and the key it is stored under
+   */
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const CachedResult> result;
+    size_t size;
+  };
+
+  /**
+   * @struct Shard
+   * @brief Results whose keys hash to the shard, most recently used first,
+   * and the searches of the shard being computed
+   */
+  struct Shard {
+    std::mutex mutex;
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> lookup;
+    std::unordered_map<std::string, std::shared_ptr<SearchFlight>> flights;
+    uint64_t version = 0;
+    size_t size = 0;
+  };
+
+  /**
+   * @brief Number of bytes the results of one shard may take
+   */
+  size_t shardCapacity;
+  /**
+   * @brief The shards
+   */
+  Shard shards[RESULT_CACHE_SHARDS];
+  /**
+   * @brief Number of searches answered from the cache
+   */
+  std::atomic<uint64_t> hitCount{0};
+  /**
+   * @brief Number of searches not found in the cache
+   */
+  std::atomic<uint64_t> missCount{0};
+  /**
+   * @brief Number of searches which read the result of the same search
+   */
+  std::atomic<uint64_t> sharedCount{0};
+
+  /**
+   * @brief Get the shard a key belongs to
+   */
+  Shard &getShard(const std::string &key);
+
+  /**
+   * @brief Drop the results of older directory versions from the shard
+   * @param shard The locked shard
+   * @param version The version of the directory being searched
+   * @return Whether the shard holds results of this version
+   */
+  static bool refresh(Shard &shard, uint64_t version);
+
+  /**
+   * @brief Stop registering the flight of a search for new readers
+   * @param shard The locked shard
+   * @param key The key of the search
+   * @param flight The flight
+   */
+  static void land(Shard &shard, const std::string &key,
+                   const std::shared_ptr<SearchFlight> &flight);
+};
+
+#endif
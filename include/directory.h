@@ -0,0 +1,188 @@
+/**
+ * @file directory.h
+ * @brief This file contains the Directory class, the in-memory entry store
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include "../include/bitmap.h"
+#include "../include/encoding.h"
+#include "../include/index.h"
+#include "../include/mappedfile.h"
+#include "../include/search.h"
+#include "../include/snapshot.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @class Directory
+ * @brief Holds all entries of the CSV file and their indexes, loaded once at
+ * startup from the CSV file or from a snapshot compiled from it
+ */
+class Directory : public std::enable_shared_from_this<Directory> {
+public:
+  Directory() {}
+  virtual ~Directory() {}
+
+  Directory(const Directory &) = delete;
+  Directory &operator=(const Directory &) = delete;
+
+  /**
+   * @brief Load the entries from the CSV file or a snapshot, snapshots are
+   * recognized by their magic and used as mapped
+   * @param filename The name of the CSV or snapshot file
+   * @param threads Number of threads parsing a CSV file
+   * @return Whether the file could be loaded
+   */
+  bool load(const std::string &filename, size_t threads = 1);
+
+  /**
+   * @brief Write the entries and indexes into a snapshot
+   * @param filename The name of the snapshot file
+   * @return Whether the snapshot could be written
+   */
+  bool save(const std::string &filename) const;
+
+  /**
+   * @brief Get all entries in the directory
+   * @return The entries in the directory
+   */
+  const EntryTable &getEntries() const { return entries; }
+
+  /**
+   * @brief Get the encoded search result bodies of the entries
+   */
+  const EntryEncodings &getEncodings() const { return encodings; }
+
+  /**
+   * @brief Get the ids of all entries
+   */
+  const Bitmap &getAllIds() const { return allIds; }
+
+  /**
+   * @brief Get the equality index of an attribute
+   * @param attribute The indexed attribute
+   */
+  const EqualityIndex &getEqualityIndex(Attribute attribute) const {
+    return equalityIndexes[static_cast<size_t>(attribute)];
+  }
+
+  /**
+   * @brief Look up an equality match in the index of its attribute
+   * @param eqMatch The equality match
+   * @param result The ids of the matching entries
+   * @return Whether the attribute is indexed
+   */
+  bool findEqual(const EqType &eqMatch, PostingList &result) const;
+
+  /**
+   * @brief Narrow down the entries which may match a substring match using
+   * the trigram index of its attribute
+   * @param subsMatch The substring match
+   * @param candidates Sorted ids of the entries which may match
+   * @return Whether the attribute is indexed and a fragment was long enough
+   */
+  bool findSubstringCandidates(const SubsType &subsMatch,
+                               std::vector<uint32_t> &candidates) const;
+
+  /**
+   * @brief Look up a substring match with only the initial part set in the
+   * prefix index of its attribute
+   * @param subsMatch The substring match
+   * @param result The ids of the matching entries, in value order
+   * @return Whether the attribute is indexed and the match is a prefix
+   */
+  bool findPrefix(const SubsType &subsMatch, PostingList &result) const;
+
+  /**
+   * @brief Look up a greaterOrEqual or lessOrEqual match in the prefix index
+   * of its attribute, entries without a value match neither
+   * @param assertion The attribute and the bound
+   * @param type GreaterOrEqual or LessOrEqual
+   * @param matching The ids of the matching entries, in value order
+   * @param rest The ids of the other entries with a value, in value order
+   * @return Whether the attribute is indexed
+   */
+  bool findRange(const EqType &assertion, FilterType type,
+                 PostingList &matching, PostingList &rest) const;
+
+  /**
+   * @brief Get the number of entries in the directory
+   */
+  size_t size() const { return entries.size(); }
+
+  /**
+   * @brief Approximate number of bytes held by the directory
+   */
+  size_t memoryUsage() const;
+
+  /**
+   * @brief Get the version the directory was published as, the first one is
+   * version zero
+   */
+  uint64_t getVersion() const { return version; }
+
+  /**
+   * @brief Set the version the directory is published as
+   */
+  void setVersion(uint64_t version) { this->version = version; }
+
+private:
+  /**
+   * @brief The version the directory was published as
+   */
+  uint64_t version = 0;
+
+  /**
+   * @brief The CSV file mapped into memory while it is parsed, or the
+   * snapshot the entries and indexes point into
+   */
+  MappedFile file;
+
+  /**
+   * @brief The entries of the CSV file
+   */
+  EntryTable entries;
+
+  /**
+   * @brief The encoded search result bodies of the entries
+   */
+  EntryEncodings encodings;
+
+  /**
+   * @brief The ids of all entries
+   */
+  Bitmap allIds;
+
+  /**
+   * @brief Equality index of every attribute
+   */
+  EqualityIndex equalityIndexes[ATTRIBUTE_COUNT];
+
+  /**
+   * @brief Trigram index of every attribute
+   */
+  TrigramIndex trigramIndexes[ATTRIBUTE_COUNT];
+
+  /**
+   * @brief Prefix index of every attribute
+   */
+  PrefixIndex prefixIndexes[ATTRIBUTE_COUNT];
+
+  /**
+   * @brief View the entries and indexes in the mapped snapshot
+   * @return Whether the snapshot is valid
+   */
+  bool loadSnapshot();
+
+  /**
+   * @brief Fold the values of an attribute into its shadow column and build
+   * the indexes of the attribute on it
+   * @param attribute The index of the attribute
+   */
+  void buildIndexes(size_t attribute);
+};
+
+#endif
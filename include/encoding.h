@@ -0,0 +1,70 @@
+/**
+ * @file encoding.h
+ * @brief This file contains the EntryEncodings class, the search result
+ * bodies of all entries encoded ahead of time
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include "../include/search.h"
+#include "../include/snapshot.h"
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @class EntryEncodings
+ * @brief The SearchResEntry body of every entry, its objectName and
+ * attributes, BER encoded once when the directory is loaded
+ */
+class EntryEncodings {
+public:
+  EntryEncodings() {}
+  virtual ~EntryEncodings() {}
+
+  /**
+   * @brief Encode the bodies of all entries
+   * @param entries The entries of the directory
+   */
+  void build(const EntryTable &entries);
+
+  /**
+   * @brief Get the encoded body of an entry
+   * @param id The id of the entry
+   */
+  std::string_view get(uint32_t id) const {
+    return std::string_view(bytes.data() + offsets[id],
+                            offsets[id + 1] - offsets[id]);
+  }
+
+  /**
+   * @brief Add the encodings to a snapshot
+   * @param writer The snapshot being written
+   */
+  void save(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the encodings in a snapshot
+   * @param reader The snapshot being read
+   * @param entries The number of entries in the snapshot
+   * @return Whether the snapshot holds valid encodings
+   */
+  bool load(SnapshotReader &reader, uint64_t entries);
+
+  /**
+   * @brief Number of bytes held by the encodings
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief The encoded bodies one after another
+   */
+  Array<char> bytes;
+  /**
+   * @brief Start of each body in bytes, one extra at the end
+   */
+  Array<uint64_t> offsets;
+};
+
+#endif
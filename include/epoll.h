@@ -0,0 +1,114 @@
+/**
+ * @file epoll.h
+ * @brief This file contains the EpollServer class, the event driven server
+ * mode
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef EPOLL_H
+#define EPOLL_H
+
+#include "../include/framer.h"
+#include "../include/output.h"
+#include "../include/store.h"
+#include "../include/threadpool.h"
+#include <thread>
+#include <vector>
+
+#define MAX_EVENTS 64
+
+/**
+ * @struct Connection
+ * @brief State of one client connection served by the epoll server
+ */
+struct Connection {
+  int fd;
+  int epollFd;
+  MessageFramer framer;
+  OutputBuffer output;
+  /**
+   * @brief Whether the connection is closed once the queued responses are
+   * sent
+   */
+  bool closing = false;
+  /**
+   * @brief Whether reading is paused until the queued responses drain below
+   * the watermark, the requests received meanwhile wait in the framer
+   */
+  bool paused = false;
+};
+
+/**
+ * @class EpollServer
+ * @brief Serves clients from one epoll reactor per core, requests are
+ * handled by a fixed pool of worker threads
+ */
+class EpollServer {
+public:
+  /**
+   * @brief Create the server
+   * @param listenFd The listening socket
+   * @param store The store holding the directory to search in
+   * @param reactors The number of epoll reactor threads
+   * @param workers The number of worker threads
+   * @param watermark Number of pending response bytes which triggers a send
+   */
+  EpollServer(int listenFd, const DirectoryStore &store, size_t reactors,
+              size_t workers, size_t watermark);
+  virtual ~EpollServer() {}
+
+  /**
+   * @brief Run the reactors, does not return unless an error occurs
+   */
+  void run();
+
+private:
+  /**
+   * @brief The listening socket
+   */
+  int listenFd;
+  /**
+   * @brief The store holding the directory to search in
+   */
+  const DirectoryStore &store;
+  /**
+   * @brief The number of reactor threads
+   */
+  size_t reactors;
+  /**
+   * @brief Number of pending response bytes which triggers a send
+   */
+  size_t watermark;
+  /**
+   * @brief Workers running parse and respond
+   */
+  ThreadPool pool;
+
+  /**
+   * @brief Reactor thread loop
+   * @param epollFd The epoll instance of this reactor
+   */
+  void reactorLoop(int epollFd);
+
+  /**
+   * @brief Accept all pending connections
+   * @param epollFd The epoll instance to register them with
+   */
+  void acceptConnections(int epollFd);
+
+  /**
+   * @brief Handle the complete requests in the framer of the connection and
+   * pause it when the responses reach the watermark
+   * @param connection The connection
+   */
+  void handleRequests(Connection *connection);
+
+  /**
+   * @brief Send the queued responses, read and handle all requests available
+   * on the connection, then rearm or close it, the worker never waits for
+   * the socket
+   * @param connection The connection to serve
+   */
+  void serveConnection(Connection *connection);
+};
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file framer.h
+ * @brief This file contains the MessageFramer class, which splits the
+ * received byte stream into LDAP messages
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <string_view>
+#include <vector>
+
+#define MAX_PDU_SIZE (16 * 1024 * 1024) // 16MB
+
+/**
+ * @enum FrameStatus
+ * @brief The result of extracting a message from the stream
+ */
+enum class FrameStatus {
+  Complete,
+  Incomplete,
+  Invalid,
+};
+
+/**
+ * @class MessageFramer
+ * @brief Per connection buffer reassembling LDAP messages split across
+ * several reads and splitting pipelined messages received in one read
+ */
+class MessageFramer {
+public:
+  MessageFramer() {}
+  virtual ~MessageFramer() {}
+
+  /**
+   * @brief Append received bytes to the stream
+   * @param data The received bytes
+   * @param size The number of received bytes
+   */
+  void append(const unsigned char *data, size_t size);
+
+  /**
+   * @brief Extract the next complete message from the stream
+   * @param pdu The message to be returned, it points into the framer and
+   * stays valid until more bytes are appended
+   * @return Complete if a message was extracted, Incomplete if more bytes
+   * are needed and Invalid if the stream is not a sequence of BER messages
+   */
+  FrameStatus next(std::string_view &pdu);
+
+private:
+  /**
+   * @brief The received bytes not yet extracted as messages
+   */
+  std::vector<unsigned char> buffer;
+
+  /**
+   * @brief The position of the first unconsumed byte in the buffer
+   */
+  size_t start = 0;
+};
+
+#endif
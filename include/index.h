@@ -0,0 +1,232 @@
+/**
+ * @file index.h
+ * @brief This file contains the attribute indexes of the directory
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "../include/search.h"
+#include "../include/snapshot.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct PostingList
+ * @brief Ids of the entries matching an index lookup, ascending unless the
+ * index says otherwise
+ */
+struct PostingList {
+  const uint32_t *first = nullptr;
+  const uint32_t *last = nullptr;
+
+  const uint32_t *begin() const { return first; }
+  const uint32_t *end() const { return last; }
+  size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
+};
+
+/**
+ * @brief Stable 64-bit FNV-1a hash of a string
+ * @param data The string to hash
+ * @param size The length of the string
+ * @return The hash
+ */
+uint64_t hashString(const char *data, size_t size);
+
+/**
+ * @class EqualityIndex
+ * @brief Open addressing hash index mapping attribute values to entry ids
+ */
+class EqualityIndex {
+public:
+  EqualityIndex() {}
+  virtual ~EqualityIndex() {}
+
+  /**
+   * @brief Build the index over the values of one attribute
+   * @param column The values to index
+   */
+  void build(const Column &column);
+
+  /**
+   * @brief Find the entries with the value
+   * @param value The value to look up
+   * @param column The indexed values
+   * @return The ids of the matching entries
+   */
+  PostingList find(std::string_view value, const Column &column) const;
+
+  /**
+   * @brief Add the index to a snapshot
+   * @param writer The snapshot being written
+   */
+  void save(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the index in a snapshot
+   * @param reader The snapshot being read
+   * @return Whether the snapshot holds a valid index
+   */
+  bool load(SnapshotReader &reader);
+
+  /**
+   * @brief Number of bytes held by the index
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief Hash table slots, value group + 1 or 0 for an empty slot
+   */
+  Array<uint32_t> slots;
+  /**
+   * @brief Low bits of the hash of each slot, to skip most value compares
+   */
+  Array<uint32_t> slotHashes;
+  /**
+   * @brief Start of each value group in postings, one extra at the end
+   */
+  Array<uint32_t> offsets;
+  /**
+   * @brief Entry ids grouped by value, ascending within a group
+   */
+  Array<uint32_t> postings;
+};
+
+/**
+ * @class TrigramIndex
+ * @brief Inverted index mapping every three character substring of an
+ * attribute to the entries containing it
+ */
+class TrigramIndex {
+public:
+  TrigramIndex() {}
+  virtual ~TrigramIndex() {}
+
+  /**
+   * @brief Build the index over the values of one attribute
+   * @param column The values to index
+   */
+  void build(const Column &column);
+
+  /**
+   * @brief Find the entries containing every trigram of the fragment
+   * @param fragment The substring to look up, at least three characters
+   * @param candidates Sorted ids of the entries which may contain the
+   * fragment
+   * @return Whether the fragment was long enough to use the index
+   */
+  bool findCandidates(std::string_view fragment,
+                      std::vector<uint32_t> &candidates) const;
+
+  /**
+   * @brief Add the index to a snapshot
+   * @param writer The snapshot being written
+   */
+  void save(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the index in a snapshot
+   * @param reader The snapshot being read
+   * @return Whether the snapshot holds a valid index
+   */
+  bool load(SnapshotReader &reader);
+
+  /**
+   * @brief Number of bytes held by the index
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief Sorted distinct trigrams, three bytes packed into an integer
+   */
+  Array<uint32_t> trigrams;
+  /**
+   * @brief Start of each trigram in postings, one extra at the end
+   */
+  Array<uint32_t> offsets;
+  /**
+   * @brief Entry ids grouped by trigram, ascending within a group
+   */
+  Array<uint32_t> postings;
+
+  /**
+   * @brief Find the entries containing the trigram
+   * @param trigram The packed trigram
+   * @return The ids of the entries
+   */
+  PostingList find(uint32_t trigram) const;
+};
+
+/**
+ * @class PrefixIndex
+ * @brief Entry ids sorted by the value of an attribute, values starting
+ * with the same prefix form a contiguous range
+ */
+class PrefixIndex {
+public:
+  PrefixIndex() {}
+  virtual ~PrefixIndex() {}
+
+  /**
+   * @brief Build the index over the values of one attribute
+   * @param column The values to index
+   */
+  void build(const Column &column);
+
+  /**
+   * @brief Find the entries with the value starting with the prefix
+   * @param prefix The prefix to look up
+   * @param column The indexed values
+   * @return The ids of the matching entries, in value order
+   */
+  PostingList find(std::string_view prefix, const Column &column) const;
+
+  /**
+   * @brief Split the entries with a value at a bound, entries with an empty
+   * value have none and are in neither part
+   * @param bound The value to split at
+   * @param inclusive Whether values equal to the bound are below it
+   * @param column The indexed values
+   * @param below The ids of the entries with a value below the bound, in
+   * value order
+   * @param above The ids of the other entries with a value, in value order
+   */
+  void split(std::string_view bound, bool inclusive, const Column &column,
+             PostingList &below, PostingList &above) const;
+
+  /**
+   * @brief Get the number of indexed entries
+   */
+  size_t size() const { return sorted.size(); }
+
+  /**
+   * @brief Add the index to a snapshot
+   * @param writer The snapshot being written
+   */
+  void save(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the index in a snapshot
+   * @param reader The snapshot being read
+   * @return Whether the snapshot holds a valid index
+   */
+  bool load(SnapshotReader &reader);
+
+  /**
+   * @brief Number of bytes held by the index
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief Entry ids ordered by value, equal values ordered by id
+   */
+  Array<uint32_t> sorted;
+};
+
+#endif
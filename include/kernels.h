@@ -0,0 +1,68 @@
+/**
+ * @file kernels.h
+ * @brief This file contains the byte matching and case folding kernels,
+ * vectorised with SSE4.2 or AVX2 when the CPU supports it
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+/**
+ * @brief Find the first occurrence of the needle in the haystack, the
+ * kernel is picked for the CPU on first use
+ * @param haystack The value to search in
+ * @param needle The bytes to look for
+ * @param start The position to start searching at
+ * @return The position of the needle or std::string_view::npos
+ */
+size_t findBytes(std::string_view haystack, std::string_view needle,
+                 size_t start);
+
+/**
+ * @brief Fold ASCII upper case letters and the UTF-8 encoded upper case
+ * letters of the Latin-1 Supplement and Latin Extended-A blocks to lower
+ * case, other bytes are copied as they are, only letters whose lower case
+ * has the same length are folded, so the folded value keeps its length
+ * @param source The bytes to fold
+ * @param target Where to write the folded bytes, may be the source
+ * @param size The number of bytes
+ */
+void foldBytes(const char *source, char *target, size_t size);
+
+/**
+ * @brief Check whether the value starts with the prefix
+ * @param value The value to check
+ * @param prefix The prefix
+ */
+inline bool startsWithBytes(std::string_view value, std::string_view prefix) {
+  return value.size() >= prefix.size() &&
+         memcmp(value.data(), prefix.data(), prefix.size()) == 0;
+}
+
+/**
+ * @brief Check whether the value ends with the suffix
+ * @param value The value to check
+ * @param suffix The suffix
+ */
+inline bool endsWithBytes(std::string_view value, std::string_view suffix) {
+  return value.size() >= suffix.size() &&
+         memcmp(value.data() + value.size() - suffix.size(), suffix.data(),
+                suffix.size()) == 0;
+}
+
+/**
+ * @brief Check whether two values are equal, the lengths are compared
+ * before any byte
+ * @param value The value to check
+ * @param pattern The value to compare with
+ */
+inline bool equalBytes(std::string_view value, std::string_view pattern) {
+  return value.size() == pattern.size() &&
+         memcmp(value.data(), pattern.data(), pattern.size()) == 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file mappedfile.h
+ * @brief This file contains the MappedFile class, a read-only memory mapping
+ * of a file
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+
+/**
+ * @class MappedFile
+ * @brief Maps a whole file read-only into memory, unmapped on destruction
+ */
+class MappedFile {
+public:
+  MappedFile() {}
+  virtual ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /**
+   * @brief Map the file
+   * @param filename The name of the file
+   * @return Whether the file could be mapped
+   */
+  bool open(const std::string &filename);
+
+  /**
+   * @brief Unmap the file, once nothing points into it
+   */
+  void close();
+
+  /**
+   * @brief Get the contents of the file
+   */
+  const char *data() const { return static_cast<const char *>(address); }
+
+  /**
+   * @brief Get the size of the file
+   */
+  size_t size() const { return length; }
+
+private:
+  /**
+   * @brief Start of the mapping, nullptr for an empty file
+   */
+  void *address = nullptr;
+  /**
+   * @brief Length of the mapping
+   */
+  size_t length = 0;
+};
+
+#endif
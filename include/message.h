@@ -7,10 +7,20 @@
 #define REQUEST_H
 
 #include "../include/ber.h"
+#include "../include/bitmap.h"
+#include "../include/cache.h"
+#include "../include/directory.h"
+#include "../include/framer.h"
+#include "../include/output.h"
+#include "../include/program.h"
 #include "../include/search.h"
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
+
+#define BUFFER_SIZE 32768 // 32KB
 
 /**
  * @enum LDAPRequestType
@@ -29,26 +39,28 @@ enum class LDAPRequestType {
  */
 class LDAPMessage {
 public:
-  LDAPMessage(std::vector<unsigned char> &buffer) : parser(buffer) { init(); }
+  LDAPMessage(std::string_view buffer) : parser(buffer) { init(); }
   virtual ~LDAPMessage() {}
 
   /**
-   * @brief Get the message ID
+   * @brief Parse the request
+   * @return Whether the request is valid, an invalid one closes the
+   * connection
    */
-  virtual void parse() = 0;
+  virtual bool parse() = 0;
 
   /**
    * @brief Respond to the LDAP message
-   * @param fd The file descriptor to write to
-   * @param inputFile The input file to read from
+   * @param output The output buffer of the connection
+   * @param directory The directory to search in
    */
-  virtual void respond(int fd, std::string inputFile) = 0;
+  virtual void respond(OutputBuffer &output, const Directory &directory) = 0;
 
 protected:
   /**
-   * @brief The message ID
+   * @brief The message ID, echoed in every response
    */
-  unsigned char messageID;
+  int32_t messageID = 0;
   /**
    * @brief The protocol op
    */
@@ -62,6 +74,16 @@ protected:
    * @brief Initialize the LDAP message
    */
   void init();
+
+  /**
+   * @brief Send a response holding only an LDAPResult
+   * @param output The output buffer of the connection
+   * @param messageID The message ID of the request
+   * @param protocolOp The protocol op of the response
+   * @param resultCode The result code
+   */
+  static void sendResult(OutputBuffer &output, int32_t messageID,
+                         unsigned char protocolOp, unsigned char resultCode);
 };
 
 /**
@@ -70,15 +92,15 @@ protected:
  */
 class Bind : public LDAPMessage {
 public:
-  Bind(std::vector<unsigned char> &buffer) : LDAPMessage(buffer) {}
+  Bind(std::string_view buffer) : LDAPMessage(buffer) {}
   /**
    * @brief Parse the Bind request
    */
-  void parse() override;
+  bool parse() override;
   /**
    * @brief Respond to the Bind request
    */
-  void respond(int fd, std::string inputFile) override;
+  void respond(OutputBuffer &output, const Directory &directory) override;
 
 private:
 };
@@ -89,66 +111,154 @@ private:
  */
 class Search : public LDAPMessage {
 public:
-  Search(std::vector<unsigned char> &buffer) : LDAPMessage(buffer) {}
+  Search(std::string_view buffer) : LDAPMessage(buffer) {}
   /**
    * @brief Parse the Search request
    */
-  void parse() override;
+  bool parse() override;
   /**
    * @brief Respond to the Search request
    */
-  void respond(int fd, std::string inputFile) override;
+  void respond(OutputBuffer &output, const Directory &directory) override;
+
+  /**
+   * @brief Set the cache shared by all searches, nothing is cached without
+   * one
+   * @param cache The cache, it has to outlive every search
+   */
+  static void setResultCache(ResultCache *cache);
 
 private:
+  /**
+   * @struct Tail
+   * @brief The matches left unsent when the client stopped taking the
+   * responses, they are encoded only as the output drains
+   */
+  struct Tail {
+    /**
+     * @brief The message ID of the search
+     */
+    int32_t messageID = 0;
+    /**
+     * @brief The encoded entries, the output holds their directory
+     */
+    const EntryEncodings *encodings = nullptr;
+    /**
+     * @brief The ids of the unsent matches
+     */
+    Bitmap ids;
+    /**
+     * @brief The first id not sent yet
+     */
+    uint32_t next = 0;
+    /**
+     * @brief The result code of the search result done
+     */
+    unsigned char resultCode = 0;
+
+    /**
+     * @brief Queue entries until the output is full, the search result done
+     * after the last one
+     * @param output The output buffer of the connection
+     * @return Whether entries are left
+     */
+    bool operator()(OutputBuffer &output);
+  };
+
   /**
    * @brief The base object
    */
-  std::vector<unsigned char> baseObject;
+  std::string_view baseObject;
   /**
    * @brief The scope
    */
-  unsigned char scope;
+  int32_t scope;
   /**
    * @brief The deref aliases
    */
-  unsigned char derefAliases;
+  int32_t derefAliases;
   /**
-   * @brief The size limit
+   * @brief The size limit, no limit when it is not positive
    */
-  unsigned char sizeLimit = 0;
+  int32_t sizeLimit = 0;
   /**
    * @brief The time limit
    */
-  unsigned char timeLimit;
+  int32_t timeLimit;
   /**
    * @brief The types only
    */
   unsigned char typesOnly;
+  /**
+   * @brief The nested filters, freed together with the request
+   */
+  Arena arena;
   /**
    * @brief The filter
    */
-  Filter filter;
+  Filter filter = {};
+  /**
+   * @brief The filter compiled for matching entries
+   */
+  FilterProgram program;
 
   /**
-   * @brief Add attribute to the response
-   * @param response The response to add to
-   * @param type The type of the attribute
-   * @param value The value of the attribute
+   * @brief The matches not sent while the output is full
    */
-  void addAttribute(std::vector<unsigned char> &response,
-                    const std::string &type, const std::string &value);
+  Tail tail;
 
   /**
    * @brief Send the search result entry
-   * @param entry The entry to send
-   * @param fd The file descriptor to write to
+   * @param messageID The message ID of the request
+   * @param body The encoded objectName and attributes of the entry
+   * @param output The output buffer of the connection
    */
-  void sendSearchResEntry(const FileEntry &entry, int fd);
+  static void sendSearchResEntry(int32_t messageID, std::string_view body,
+                                 OutputBuffer &output);
   /**
-   * @brief Send the search result done
-   * @param fd The file descriptor to write to
+   * @brief Send the entry unless the client stopped taking the responses,
+   * then it is left to the tail with every following one
+   * @param id The id of the entry
+   * @param encodings The encoded entries of the directory
+   * @param output The output buffer of the connection
    */
-  void sendSearchResDone(int fd, bool sizeLimitReached);
+  void sendEntry(uint32_t id, const EntryEncodings &encodings,
+                 OutputBuffer &output);
+  /**
+   * @brief Send the search result done, after the tail if there is one
+   * @param output The output buffer of the connection
+   */
+  void sendSearchResDone(OutputBuffer &output, bool sizeLimitReached);
+  /**
+   * @brief Find the entries matching the filter and send them
+   * @param output The output buffer of the connection
+   * @param directory The directory to search in
+   * @param skip Number of the first matches sent already
+   * @param found Called with the id of every sent entry, may be empty
+   * @return Whether the size limit was reached
+   */
+  bool sendMatches(OutputBuffer &output, const Directory &directory,
+                   size_t skip, const std::function<void(uint32_t)> &found);
+  /**
+   * @brief Send the matches and publish them to the searches reading the
+   * flight, then complete it
+   * @param output The output buffer of the connection
+   * @param directory The directory to search in
+   * @param key The key of the search
+   * @param flight The flight led by this search
+   */
+  void leadSearch(OutputBuffer &output, const Directory &directory,
+                  const std::string &key,
+                  std::shared_ptr<SearchFlight> flight);
+  /**
+   * @brief Send the matches published by the identical search leading the
+   * flight, the rest is found here if it abandons the flight
+   * @param output The output buffer of the connection
+   * @param directory The directory to search in
+   * @param flight The flight joined by this search
+   */
+  void followSearch(OutputBuffer &output, const Directory &directory,
+                    const std::shared_ptr<SearchFlight> &flight);
 };
 
 /**
@@ -157,26 +267,49 @@ private:
  */
 class Unbind : public LDAPMessage {
 public:
-  Unbind(std::vector<unsigned char> &buffer) : LDAPMessage(buffer) {}
+  Unbind(std::string_view buffer) : LDAPMessage(buffer) {}
   /**
    * @brief Parse the Unbind request
    */
-  void parse() override;
+  bool parse() override;
   /**
    * @brief Respond to the Unbind request (This one is just to comply with
    * polymorphism)
    */
-  void respond(int fd, std::string inputFile) override;
+  void respond(OutputBuffer &output, const Directory &directory) override;
 
 private:
 };
 
 /**
  * @brief Create an LDAP request from the buffer
- * @param buffer The buffer to create the request from
+ * @param buffer The buffer to create the request from, it has to outlive the
+ * request
  * @return The LDAP request
  */
-std::unique_ptr<LDAPMessage>
-createLDAPRequest(std::vector<unsigned char> &buffer);
+std::unique_ptr<LDAPMessage> createLDAPRequest(std::string_view buffer);
+
+/**
+ * @brief Parse the request in the buffer and respond to it
+ * @param buffer The buffer holding the request
+ * @param output The output buffer of the connection
+ * @param directory The directory to search in
+ * @return Whether the connection should stay open
+ */
+bool handleLDAPRequest(std::string_view buffer, OutputBuffer &output,
+                       const Directory &directory);
+
+/**
+ * @brief Handle every complete request received on the connection so far,
+ * the responses are sent together once all of them are handled, handling
+ * stops early while the queued responses stay over the watermark or a search
+ * has matches left
+ * @param framer The framer holding the received bytes of the connection
+ * @param output The output buffer of the connection
+ * @param directory The directory to search in
+ * @return Whether the connection should stay open
+ */
+bool handleReceivedData(MessageFramer &framer, OutputBuffer &output,
+                        const Directory &directory);
 
 #endif
\ No newline at end of file
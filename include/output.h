@@ -0,0 +1,174 @@
+/**
+ * @file output.h
+ * @brief This file contains the OutputBuffer class, which batches the
+ * responses of a connection into few large sends
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#define OUTPUT_WATERMARK 65536 // 64KB
+
+// Smaller views are copied, a gathered segment would cost more than the copy
+#define OUTPUT_VIEW_MIN_SIZE 512
+
+/**
+ * @class OutputBuffer
+ * @brief Collects the responses of one connection and sends them with
+ * gathered writes once the watermark is reached or the requests are handled,
+ * what a non-blocking socket does not take stays queued until it is writable
+ * again, the storage is reused so steady traffic does not allocate, data
+ * produced late is deferred so the queue stays near the watermark
+ */
+class OutputBuffer {
+public:
+  /**
+   * @brief Create the buffer
+   * @param fd The file descriptor to write to
+   * @param watermark Number of pending bytes which triggers a send
+   */
+  OutputBuffer(int fd, size_t watermark = OUTPUT_WATERMARK)
+      : fd(fd), watermark(watermark) {}
+  virtual ~OutputBuffer() {}
+
+  /**
+   * @brief Queue space for data written by the caller, valid until the next
+   * call on the buffer
+   * @param size The number of bytes
+   * @return The space to write the bytes to
+   */
+  unsigned char *reserve(size_t size);
+
+  /**
+   * @brief Queue a copy of the data
+   * @param data The data to send
+   * @param size The size of the data
+   */
+  void append(const void *data, size_t size);
+
+  /**
+   * @brief Queue the data without copying it unless it is small, it must
+   * stay valid until the buffer is flushed
+   * @param data The data to send
+   * @param size The size of the data
+   */
+  void appendView(const void *data, size_t size);
+
+  /**
+   * @brief Send as much of the queued data as the socket takes, never waits
+   * for a non-blocking socket, the rest stays queued
+   * @param more Whether more data follows soon, lets the kernel hold back a
+   * partial segment
+   * @return Whether no send failed
+   */
+  bool flush(bool more = false);
+
+  /**
+   * @brief Queue the data of the source after the queued data, the source is
+   * called whenever the socket took everything queued and queues some of it,
+   * until it returns false
+   * @param source Queues data until the buffer is full, returns whether data
+   * is left
+   */
+  void defer(std::function<bool(OutputBuffer &)> source);
+
+  /**
+   * @brief Keep the owner of viewed data alive until everything queued or
+   * deferred is sent
+   * @param owner The owner of the data
+   */
+  void hold(std::shared_ptr<const void> owner);
+
+  /**
+   * @brief Get the number of queued bytes
+   */
+  size_t size() const { return pending; }
+
+  /**
+   * @brief Check whether nothing is queued or deferred
+   */
+  bool empty() const { return pending == 0 && source == nullptr; }
+
+  /**
+   * @brief Check whether the queued bytes reached the watermark or data is
+   * deferred, no more requests should be handled until the client takes them
+   */
+  bool full() const {
+    return (pending > 0 && pending >= watermark) || source != nullptr;
+  }
+
+  /**
+   * @brief Check whether a send failed, the connection should be closed
+   */
+  bool failed() const { return error; }
+
+private:
+  /**
+   * @struct Segment
+   * @brief Part of the queued data, either owned at an offset or viewed
+   */
+  struct Segment {
+    const void *data;
+    size_t offset;
+    size_t size;
+  };
+
+  /**
+   * @brief The file descriptor to write to
+   */
+  int fd;
+  /**
+   * @brief Number of pending bytes which triggers a send
+   */
+  size_t watermark;
+  /**
+   * @brief Copies of the appended data
+   */
+  std::vector<unsigned char> owned;
+  /**
+   * @brief The queued data in order
+   */
+  std::vector<Segment> segments;
+  /**
+   * @brief Index of the first segment not sent yet
+   */
+  size_t first = 0;
+  /**
+   * @brief Owners of the viewed data queued
+   */
+  std::vector<std::shared_ptr<const void>> owners;
+  /**
+   * @brief Number of queued bytes
+   */
+  size_t pending = 0;
+  /**
+   * @brief Source of the deferred data, empty when there is none
+   */
+  std::function<bool(OutputBuffer &)> source;
+  /**
+   * @brief Whether the source is queuing its data
+   */
+  bool refilling = false;
+  /**
+   * @brief Whether the last send found the send buffer full, queuing more
+   * does not try again until the next flush
+   */
+  bool blocked = false;
+  /**
+   * @brief Whether a send failed
+   */
+  bool error = false;
+
+  /**
+   * @brief Send as much of the queued data as the socket takes
+   * @param more Whether more data follows soon
+   */
+  void sendQueued(bool more);
+};
+
+#endif
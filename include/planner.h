@@ -0,0 +1,106 @@
+/**
+ * @file planner.h
+ * @brief This file contains the FilterPlanner class, which evaluates filters
+ * as set operations over the directory indexes
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "../include/bitmap.h"
+#include "../include/directory.h"
+#include "../include/program.h"
+#include "../include/search.h"
+#include <functional>
+
+/**
+ * @struct FilterPlan
+ * @brief Entries in sure match the filter, entries in maybe have to be
+ * checked against it, any other entry does not match
+ */
+struct FilterPlan {
+  Bitmap sure;
+  Bitmap maybe;
+};
+
+/**
+ * @class FilterPlanner
+ * @brief Turns a filter tree into set operations on index posting lists
+ */
+class FilterPlanner {
+public:
+  FilterPlanner(const Directory &directory);
+  virtual ~FilterPlanner() {}
+
+  /**
+   * @brief Plan the filter
+   * @param filter The filter to plan
+   * @return The plan of the filter
+   */
+  FilterPlan plan(const Filter &filter) const;
+
+  /**
+   * @brief Visit the entries matching the filter in file order, undecided
+   * entries are checked only when they are reached, many of them are
+   * checked ahead on the scan pool
+   * @param filter The filter to apply
+   * @param program The filter compiled, checks the undecided entries
+   * @param limit Number of matches after which checking can stop, 0 for all
+   * @param visit Called with the id of every match, returns false to stop
+   */
+  void match(const Filter &filter, const FilterProgram &program, size_t limit,
+             const std::function<bool(uint32_t)> &visit) const;
+
+  /**
+   * @brief Set the number of threads checking the entries of one search,
+   * including the searching thread, 1 checks them all on it
+   * @param threads The number of threads
+   */
+  static void setScanThreads(size_t threads);
+
+private:
+  /**
+   * @brief The directory to search in
+   */
+  const Directory &directory;
+
+  /**
+   * @brief Every entry of the directory
+   */
+  const Bitmap &universe;
+
+  /**
+   * @brief Check the candidates one range of ids per task on the scan pool
+   * and visit the matches in order
+   * @param plan The plan of the filter
+   * @param candidates The ids in the sure or maybe set of the plan
+   * @param program The filter compiled, checks the maybe set
+   * @param limit Number of matches after which checking can stop, 0 for all
+   * @param visit Called with the id of every match, returns false to stop
+   */
+  void matchParallel(const FilterPlan &plan, const Bitmap &candidates,
+                     const FilterProgram &program, size_t limit,
+                     const std::function<bool(uint32_t)> &visit) const;
+
+  /**
+   * @brief Plan a leaf of the filter tree
+   */
+  FilterPlan planLeaf(const Filter &filter) const;
+
+  /**
+   * @brief Plan the AND filter, cheapest child first
+   */
+  FilterPlan planAND(const ArenaArray<Filter> &filters) const;
+
+  /**
+   * @brief Plan the OR filter
+   */
+  FilterPlan planOR(const ArenaArray<Filter> &filters) const;
+
+  /**
+   * @brief Plan the NOT filter
+   */
+  FilterPlan planNOT(const Filter &filter) const;
+};
+
+#endif
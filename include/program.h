@@ -0,0 +1,140 @@
+/**
+ * @file program.h
+ * @brief This file contains the FilterProgram class, a filter tree compiled
+ * into a flat list of instructions
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "../include/search.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @enum OpCode
+ * @brief The instructions of a filter program
+ */
+enum class OpCode : uint8_t {
+  True,
+  False,
+  Equal,
+  GreaterOrEqual,
+  LessOrEqual,
+  Present,
+  Substring,
+  Not,
+  JumpIfFalse,
+  JumpIfTrue,
+};
+
+/**
+ * @struct Instruction
+ * @brief One step of a filter program, leaves set the result register and
+ * jumps skip the rest of AND or OR once the result is known
+ */
+struct Instruction {
+  OpCode op;
+  /**
+   * @brief Index of the attribute for leaves, ATTRIBUTE_COUNT for unknown
+   */
+  uint8_t attribute;
+  /**
+   * @brief Pattern of the leaf or target of the jump
+   */
+  uint32_t operand;
+};
+
+/**
+ * @struct Pattern
+ * @brief Position of a string in the text of the program
+ */
+struct Pattern {
+  uint32_t offset;
+  uint32_t length;
+};
+
+/**
+ * @struct SubstringPattern
+ * @brief Substring match with the any parts stored as a range of patterns
+ */
+struct SubstringPattern {
+  Pattern initial;
+  Pattern final;
+  uint32_t firstAny;
+  uint32_t anyCount;
+};
+
+/**
+ * @class FilterProgram
+ * @brief Filter tree flattened into instructions with attributes resolved,
+ * so matching an entry does no attribute name compares and no allocations
+ */
+class FilterProgram {
+public:
+  FilterProgram() {}
+  virtual ~FilterProgram() {}
+
+  /**
+   * @brief Compile the filter into the program
+   * @param filter The filter to compile
+   */
+  void compile(const Filter &filter);
+
+  /**
+   * @brief Check whether the entry matches the compiled filter
+   * @param entries The entries of the directory
+   * @param id The id of the entry to check
+   * @return Whether the entry matches
+   */
+  bool matches(const EntryTable &entries, uint32_t id) const;
+
+private:
+  /**
+   * @brief The instructions
+   */
+  std::vector<Instruction> code;
+  /**
+   * @brief Values of the equality, ordering and approximate matches
+   */
+  std::vector<Pattern> values;
+  /**
+   * @brief The substring matches
+   */
+  std::vector<SubstringPattern> substrings;
+  /**
+   * @brief The any parts of all substring matches
+   */
+  std::vector<Pattern> anyParts;
+  /**
+   * @brief All strings of the program, one after another
+   */
+  std::string text;
+
+  /**
+   * @brief Compile a node of the filter tree
+   */
+  void compileNode(const Filter &filter);
+
+  /**
+   * @brief Store a string in the text of the program
+   */
+  Pattern addText(std::string_view str);
+
+  /**
+   * @brief Get the string of a pattern
+   */
+  std::string_view getText(const Pattern &pattern) const {
+    return std::string_view(text.data() + pattern.offset, pattern.length);
+  }
+
+  /**
+   * @brief Check the substring match against the value
+   */
+  bool matchSubstring(std::string_view value,
+                      const SubstringPattern &pattern) const;
+};
+
+#endif
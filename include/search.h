@@ -6,37 +6,171 @@
 #ifndef SEARCH_H
 #define SEARCH_H
 
+#include "../include/arena.h"
+#include "../include/snapshot.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /**
- * @struct FileEntry
- * @brief The entry in the CSV file
+ * @enum Attribute
+ * @brief The attributes of an entry
  */
-struct FileEntry {
-  std::string cn;
-  std::string uid;
-  std::string mail;
+enum class Attribute {
+  CN,
+  UID,
+  MAIL,
+};
+
+#define ATTRIBUTE_COUNT 3
+
+/**
+ * @brief Get the attribute by its name
+ * @param name The name of the attribute
+ * @param attribute The attribute to be returned
+ * @return Whether the name is a known attribute
+ */
+bool getAttributeType(std::string_view name, Attribute &attribute);
+
+/**
+ * @class Column
+ * @brief Values of one attribute of all entries, stored one after another
+ * in a single arena, so a scan over the attribute reads memory sequentially
+ */
+class Column {
+public:
+  Column() {}
+  virtual ~Column() {}
+
+  /**
+   * @brief Take over the values of all entries
+   * @param values All values, one after another
+   * @param offsets The start of every value in the values
+   * @param lengths The length of every value
+   */
+  void assign(std::vector<char> &&values, std::vector<uint64_t> &&offsets,
+              std::vector<uint32_t> &&lengths);
+
+  /**
+   * @brief Make the column a case folded shadow of another one, folding
+   * keeps every value at its offset, so the offsets and lengths are shared
+   * @param column The column to fold
+   */
+  void fold(const Column &column);
+
+  /**
+   * @brief Add the values to a snapshot
+   * @param writer The snapshot being written
+   */
+  void save(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the values in a snapshot
+   * @param reader The snapshot being read
+   * @return Whether the snapshot holds valid values
+   */
+  bool load(SnapshotReader &reader);
+
+  /**
+   * @brief Add the values of a shadow to a snapshot, without the shared
+   * offsets and lengths
+   * @param writer The snapshot being written
+   */
+  void saveFolded(SnapshotWriter &writer) const;
+
+  /**
+   * @brief View the values of a shadow in a snapshot
+   * @param column The column the shadow was folded from
+   * @param reader The snapshot being read
+   * @return Whether the snapshot holds values laid out like the column
+   */
+  bool loadFolded(const Column &column, SnapshotReader &reader);
+
+  /**
+   * @brief Get the value of an entry
+   * @param id The id of the entry
+   */
+  std::string_view get(uint32_t id) const {
+    return std::string_view(values.data() + offsets[id], lengths[id]);
+  }
+
+  /**
+   * @brief Get the number of values
+   */
+  size_t size() const { return lengths.size(); }
+
+  /**
+   * @brief Number of bytes held by the column
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief All values, one after another
+   */
+  Array<char> values;
+  /**
+   * @brief Start of each value in the arena
+   */
+  Array<uint64_t> offsets;
+  /**
+   * @brief Length of each value
+   */
+  Array<uint32_t> lengths;
+};
+
+/**
+ * @struct EntryTable
+ * @brief The entries of the CSV file, one column per attribute and a case
+ * folded shadow of it, which filters are matched against
+ */
+struct EntryTable {
+  Column columns[ATTRIBUTE_COUNT];
+  Column folded[ATTRIBUTE_COUNT];
+
+  /**
+   * @brief Get the column of an attribute
+   */
+  const Column &getColumn(Attribute attribute) const {
+    return columns[static_cast<size_t>(attribute)];
+  }
+  Column &getColumn(Attribute attribute) {
+    return columns[static_cast<size_t>(attribute)];
+  }
+
+  /**
+   * @brief Get the case folded column of an attribute
+   */
+  const Column &getFoldedColumn(Attribute attribute) const {
+    return folded[static_cast<size_t>(attribute)];
+  }
+
+  /**
+   * @brief Get the number of entries
+   */
+  size_t size() const { return columns[0].size(); }
 };
 
 /**
  * @struct EqType
- * @brief The equality match type
+ * @brief The attribute value assertion of equality, ordering and approximate
+ * matches, the strings point into the request
  */
 struct EqType {
-  std::string type;
-  std::string value;
+  std::string_view type;
+  std::string_view value;
 };
 
 /**
  * @struct SubsType
- * @brief The substring match type
+ * @brief The substring match type, the strings point into the request
  */
 struct SubsType {
-  std::string type;
-  std::string initial;
-  std::vector<std::string> any;
-  std::string final;
+  std::string_view type;
+  std::string_view initial;
+  ArenaArray<std::string_view> any;
+  std::string_view final;
 };
 
 /**
@@ -46,75 +180,56 @@ struct SubsType {
 enum FilterType {
   EqualityMatch = 0xA3,
   SubstringMatch = 0xA4,
+  GreaterOrEqual = 0xA5,
+  LessOrEqual = 0xA6,
+  ApproxMatch = 0xA8,
   AND = 0xA0,
   OR = 0xA1,
   NOT = 0xA2,
-  ALL = 0x87,
+  Present = 0x87,
 };
 
 /**
  * @struct Filter
- * @brief Tree like structure for filters
+ * @brief Tree like structure for filters, the nested filters are allocated in
+ * the arena of the request
  */
 struct Filter {
   FilterType type;
   EqType equalityMatch;
   SubsType substringMatch;
-  std::vector<Filter> filters;
+  std::string_view present;
+  ArenaArray<Filter> filters;
 };
 
 /**
- * @brief Read the CSV file
- * @param filename The name of the CSV file
- * @return The entries in the CSV file
- */
-std::vector<FileEntry> readCSV(const std::string &filename);
-
-/**
- * @brief Function to recursively filter the entry
- * @param filter The filter to apply
- * @param entry The entry to filter
- * @return Whether the entry matches the filter
- */
-bool filterEntry(const Filter &filter, const FileEntry &entry);
-
-/**
- * @brief Function to apply the equality match to entry
- * @param eqMatch The equality match to apply
- * @param entry The entry to apply the equality match to
- * @return Whether the entry matches the equality match
- */
-bool applyEqualityMatch(const EqType &eqMatch, const FileEntry &entry);
-
-/**
- * @brief Function to apply the substring match to entry
- * @param subsMatch The substring match to apply
- * @param entry The entry to apply the substring match to
- * @return Whether the entry matches the substring match
- */
-bool applySubstringMatch(const SubsType &subsMatch, const FileEntry &entry);
-
-/**
- * @brief Function to apply the AND filter to entry
- * @param filters The filters to apply
- * @param entry The entry to apply the filters to
+ * @brief Check whether the attribute of a present filter is objectClass,
+ * which every entry has
+ * @param name The case folded name of the attribute
  */
-bool applyAND(const std::vector<Filter> &filters, const FileEntry &entry);
+inline bool isObjectClass(std::string_view name) {
+  return name == "objectclass";
+}
 
 /**
- * @brief Function to apply the OR filter to entry
- * @param filters The filters to apply
- * @param entry The entry to apply the filters to
- * @return Whether the entry matches the OR filter
+ * @brief Fold the attribute names and assertion values of the filter to
+ * lower case, matching then ignores case like the caseIgnore rules of the
+ * attributes
+ * @param filter The filter to fold
+ * @param arena The arena to allocate the folded strings in
  */
-bool applyOR(const std::vector<Filter> &filters, const FileEntry &entry);
+void foldFilter(Filter &filter, Arena &arena);
 
 /**
- * @brief Function to apply the NOT filter to entry
- * @param filter The filter to apply
- * @param entry The entry to apply the filter to
- * @return Whether the entry matches the NOT filter
+ * @brief Split the contents of the CSV file into entries, the values of every
+ * attribute are copied into the arena of its column
+ * @param data The contents of the CSV file
+ * @param size The size of the contents
+ * @param table The table to fill with the entries
+ * @param threads Number of threads parsing newline aligned chunks of the
+ * contents, the entries keep the order of the file
  */
-bool applyNOT(const Filter &filter, const FileEntry &entry);
+void readCSV(const char *data, size_t size, EntryTable &table,
+             size_t threads = 1);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,254 @@
+/**
+ * @file snapshot.h
+ * @brief This file contains the binary directory snapshot, a file holding the
+ * entries and indexes laid out so they can be used straight from a mapping
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define SNAPSHOT_MAGIC "LDAPSNAP"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_VERSION 6
+
+// Sections start on this boundary, enough for every stored type
+#define SNAPSHOT_ALIGNMENT 8
+
+/**
+ * @struct SnapshotHeader
+ * @brief Start of a snapshot file, followed by the section table
+ */
+struct SnapshotHeader {
+  char magic[SNAPSHOT_MAGIC_SIZE];
+  uint32_t version;
+  uint32_t attributes;
+  uint64_t entries;
+  uint64_t sections;
+};
+
+/**
+ * @struct SnapshotSection
+ * @brief Position of one array in the snapshot file, in bytes
+ */
+struct SnapshotSection {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * @class Array
+ * @brief Read-only array which either owns its values or views values stored
+ * elsewhere, such as in a mapped snapshot
+ */
+template <typename T> class Array {
+public:
+  Array() {}
+  virtual ~Array() {}
+
+  /**
+   * @brief Take ownership of the values
+   * @param values The values
+   */
+  explicit Array(std::vector<T> &&values)
+      : owned(std::move(values)), first(owned.data()), count(owned.size()) {}
+
+  Array(Array &&other) noexcept
+      : owned(std::move(other.owned)), first(other.first),
+        count(other.count) {
+    other.first = nullptr;
+    other.count = 0;
+  }
+
+  Array &operator=(Array &&other) noexcept {
+    owned = std::move(other.owned);
+    first = other.first;
+    count = other.count;
+    other.first = nullptr;
+    other.count = 0;
+    return *this;
+  }
+
+  Array(const Array &) = delete;
+  Array &operator=(const Array &) = delete;
+
+  /**
+   * @brief Create an array viewing values it does not own
+   * @param data The first value
+   * @param size The number of values
+   */
+  static Array view(const T *data, size_t size) {
+    Array array;
+    array.first = data;
+    array.count = size;
+    return array;
+  }
+
+  const T &operator[](size_t i) const { return first[i]; }
+  const T *data() const { return first; }
+  const T *begin() const { return first; }
+  const T *end() const { return first + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  /**
+   * @brief Number of bytes owned by the array
+   */
+  size_t memoryUsage() const { return owned.capacity() * sizeof(T); }
+
+private:
+  /**
+   * @brief The values when owned, empty for a view
+   */
+  std::vector<T> owned;
+  /**
+   * @brief The first value
+   */
+  const T *first = nullptr;
+  /**
+   * @brief The number of values
+   */
+  size_t count = 0;
+};
+
+/**
+ * @brief Check whether the contents of a file are a snapshot
+ * @param data The contents of the file
+ * @param size The size of the contents
+ */
+bool isSnapshot(const char *data, size_t size);
+
+/**
+ * @class SnapshotWriter
+ * @brief Collects arrays and writes them into a snapshot file
+ */
+class SnapshotWriter {
+public:
+  SnapshotWriter() {}
+  virtual ~SnapshotWriter() {}
+
+  /**
+   * @brief Add the next section, the values must stay valid until written
+   * @param array The values of the section
+   */
+  template <typename T> void add(const Array<T> &array) {
+    parts.push_back({array.data(), array.size() * sizeof(T)});
+  }
+
+  /**
+   * @brief Write the sections into a file, replacing it at once
+   * @param filename The name of the snapshot file
+   * @param attributes The number of attributes in the snapshot
+   * @param entries The number of entries in the snapshot
+   * @return Whether the file could be written
+   */
+  bool write(const std::string &filename, uint32_t attributes,
+             uint64_t entries) const;
+
+private:
+  /**
+   * @struct Part
+   * @brief Bytes of one section
+   */
+  struct Part {
+    const void *data;
+    size_t size;
+  };
+
+  /**
+   * @brief The sections in the order they were added
+   */
+  std::vector<Part> parts;
+};
+
+/**
+ * @class SnapshotReader
+ * @brief Reads the sections of a mapped snapshot in the order they were
+ * written, the arrays view the mapping
+ */
+class SnapshotReader {
+public:
+  SnapshotReader() {}
+  virtual ~SnapshotReader() {}
+
+  /**
+   * @brief Check the header and section table of a snapshot
+   * @param data The contents of the snapshot file
+   * @param size The size of the contents
+   * @return Whether the snapshot is valid and of the current version
+   */
+  bool open(const char *data, size_t size);
+
+  /**
+   * @brief Get the number of attributes in the snapshot
+   */
+  uint32_t attributes() const { return attributeCount; }
+
+  /**
+   * @brief Get the number of entries in the snapshot
+   */
+  uint64_t entries() const { return entryCount; }
+
+  /**
+   * @brief Read the next section
+   * @param array The array to view the section
+   * @return Whether the section exists and holds values of the type
+   */
+  template <typename T> bool read(Array<T> &array) {
+    const char *section;
+    size_t size;
+    if (!next(section, size, alignof(T)) || size % sizeof(T) != 0) {
+      return false;
+    }
+
+    array = Array<T>::view(reinterpret_cast<const T *>(section),
+                           size / sizeof(T));
+    return true;
+  }
+
+private:
+  /**
+   * @brief The contents of the snapshot file
+   */
+  const char *data = nullptr;
+  /**
+   * @brief The size of the contents
+   */
+  size_t length = 0;
+  /**
+   * @brief The section table
+   */
+  const SnapshotSection *sections = nullptr;
+  /**
+   * @brief The number of sections
+   */
+  uint64_t sectionCount = 0;
+  /**
+   * @brief The section read next
+   */
+  uint64_t current = 0;
+  /**
+   * @brief The number of attributes in the snapshot
+   */
+  uint32_t attributeCount = 0;
+  /**
+   * @brief The number of entries in the snapshot
+   */
+  uint64_t entryCount = 0;
+
+  /**
+   * @brief Advance to the next section
+   * @param section The start of the section
+   * @param size The size of the section in bytes
+   * @param alignment Required alignment of the section
+   * @return Whether there is a next section with the alignment
+   */
+  bool next(const char *&section, size_t &size, size_t alignment);
+};
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @file store.h
+ * @brief This file contains the DirectoryStore class, which publishes new
+ * versions of the directory to concurrent readers, and the DirectoryWatcher
+ * class, which reloads the directory when its file changes
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef STORE_H
+#define STORE_H
+
+#include "../include/directory.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Reader counters are spread over shards to keep readers off one cache line
+#define READER_SHARDS 64
+
+class DirectoryStore;
+
+/**
+ * @class DirectoryReader
+ * @brief Keeps the directory version current at its creation alive until it
+ * is destroyed
+ */
+class DirectoryReader {
+public:
+  DirectoryReader(DirectoryReader &&other) noexcept;
+  virtual ~DirectoryReader();
+
+  DirectoryReader(const DirectoryReader &) = delete;
+  DirectoryReader &operator=(const DirectoryReader &) = delete;
+  DirectoryReader &operator=(DirectoryReader &&) = delete;
+
+  const Directory &operator*() const { return *directory; }
+  const Directory *operator->() const { return directory; }
+
+  /**
+   * @brief Share the ownership of the version being read, it then stays
+   * alive after the reader is gone without holding back publishers
+   */
+  std::shared_ptr<const Directory> share() const {
+    return directory->shared_from_this();
+  }
+
+private:
+  friend class DirectoryStore;
+
+  /**
+   * @brief Create a reader counted in the shard and epoch parity
+   */
+  DirectoryReader(const DirectoryStore *store, size_t shard, size_t parity,
+                  const Directory *directory)
+      : store(store), shard(shard), parity(parity), directory(directory) {}
+
+  /**
+   * @brief The store the reader is counted in, nullptr once moved from
+   */
+  const DirectoryStore *store;
+  /**
+   * @brief The reader counter shard
+   */
+  size_t shard;
+  /**
+   * @brief The epoch parity the reader is counted in
+   */
+  size_t parity;
+  /**
+   * @brief The directory version being read
+   */
+  const Directory *directory;
+};
+
+/**
+ * @class DirectoryStore
+ * @brief Holds the current directory version, readers never lock and new
+ * versions are published by swapping a pointer, the store drops the old
+ * version once every reader which may have seen it is gone, it is freed then
+ * unless a reader shared its ownership
+ */
+class DirectoryStore {
+public:
+  /**
+   * @brief Create the store
+   * @param directory The first directory version
+   */
+  explicit DirectoryStore(std::unique_ptr<Directory> directory);
+  virtual ~DirectoryStore();
+
+  DirectoryStore(const DirectoryStore &) = delete;
+  DirectoryStore &operator=(const DirectoryStore &) = delete;
+
+  /**
+   * @brief Start reading the current directory version
+   * @return The reader holding the version
+   */
+  DirectoryReader acquire() const;
+
+  /**
+   * @brief Make a new directory version current, waits until readers of the
+   * old version are done and drops it
+   * @param directory The new directory version
+   */
+  void publish(std::unique_ptr<Directory> directory);
+
+  /**
+   * @brief Get the number of versions published after the first one
+   */
+  uint64_t version() const { return published.load(); }
+
+private:
+  friend class DirectoryReader;
+
+  /**
+   * @struct ReaderShard
+   * @brief Number of readers which started in an even or odd epoch
+   */
+  struct alignas(64) ReaderShard {
+    std::atomic<uint64_t> readers[2];
+  };
+
+  /**
+   * @brief Owns the current directory version, only used by publishers
+   */
+  std::shared_ptr<Directory> owner;
+  /**
+   * @brief The current directory version
+   */
+  std::atomic<Directory *> current;
+  /**
+   * @brief The epoch, flipped twice by every publish
+   */
+  std::atomic<uint64_t> epoch{0};
+  /**
+   * @brief The number of versions published after the first one
+   */
+  std::atomic<uint64_t> published{0};
+  /**
+   * @brief Reader counters
+   */
+  mutable ReaderShard shards[READER_SHARDS];
+  /**
+   * @brief Serializes publishers
+   */
+  std::mutex publishMutex;
+};
+
+/**
+ * @class DirectoryWatcher
+ * @brief Watches the directory file with inotify and publishes a freshly
+ * loaded directory whenever a new file is renamed over it
+ */
+class DirectoryWatcher {
+public:
+  /**
+   * @brief Create the watcher
+   * @param store The store to publish new versions to
+   * @param filename The CSV or snapshot file to watch
+   * @param threads Number of threads parsing a CSV file
+   */
+  DirectoryWatcher(DirectoryStore &store, const std::string &filename,
+                   size_t threads)
+      : store(store), filename(filename), threads(threads) {}
+  virtual ~DirectoryWatcher() {}
+
+  /**
+   * @brief Start watching in a background thread, which runs until the
+   * server exits
+   * @return Whether the file could be watched
+   */
+  bool start();
+
+private:
+  /**
+   * @brief The store to publish new versions to
+   */
+  DirectoryStore &store;
+  /**
+   * @brief The watched file
+   */
+  std::string filename;
+  /**
+   * @brief Number of threads parsing a CSV file
+   */
+  size_t threads;
+  /**
+   * @brief The name of the file within its folder
+   */
+  std::string name;
+  /**
+   * @brief The inotify instance
+   */
+  int inotifyFd = -1;
+
+  /**
+   * @brief Wait for changes of the file and reload it
+   */
+  void watch();
+
+  /**
+   * @brief Load the file and publish it, the current version stays if the
+   * file can not be loaded
+   */
+  void reload();
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file threadpool.h
+ * @brief This file contains the ThreadPool class
+ * @author Simon Bencik <xbenci01>
+ */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads executing submitted tasks
+ */
+class ThreadPool {
+public:
+  ThreadPool(size_t threads);
+  virtual ~ThreadPool();
+
+  /**
+   * @brief Queue a task to be run by one of the workers
+   * @param task The task to run
+   */
+  void submit(std::function<void()> task);
+
+  /**
+   * @brief Get the number of worker threads
+   */
+  size_t size() const { return workers.size(); }
+
+private:
+  /**
+   * @brief The worker threads
+   */
+  std::vector<std::thread> workers;
+
+  /**
+   * @brief Tasks waiting for a free worker
+   */
+  std::queue<std::function<void()>> tasks;
+
+  /**
+   * @brief Guards the task queue
+   */
+  std::mutex mutex;
+
+  /**
+   * @brief Signals workers that a task is available
+   */
+  std::condition_variable condition;
+
+  /**
+   * @brief Set when the pool is being destroyed
+   */
+  bool stopping = false;
+
+  /**
+   * @brief Worker thread loop
+   */
+  void work();
+};
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * @file arena.cpp
+ * @brief This file contains the Arena class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <cstdint>
+
+#include "../include/arena.h"
+
+void *Arena::allocateBytes(size_t size, size_t alignment) {
+  size_t padding = -reinterpret_cast<uintptr_t>(current) & (alignment - 1);
+
+  // Start a new block, the rest of the current one is left unused
+  if (padding + size > remaining) {
+    size_t blockSize = std::max<size_t>(ARENA_BLOCK_SIZE, size + alignment);
+    blocks.emplace_back(new unsigned char[blockSize]);
+    current = blocks.back().get();
+    remaining = blockSize;
+    padding = -reinterpret_cast<uintptr_t>(current) & (alignment - 1);
+  }
+
+  void *result = current + padding;
+  current += padding + size;
+  remaining -= padding + size;
+  return result;
+}
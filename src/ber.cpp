@@ -1,39 +1,61 @@
 /**
  * @file ber.cpp
- * @brief This file contains the BERParser class implementation
+ * @brief This file contains the BERParser and BEREncoder classes implementation
  * @author Simon Bencik <xbenci01>
  */
 #include "../include/ber.h"
+#include <cstring>
 #include <iostream>
 #include <vector>
 
-BERParser::BERParser(std::vector<unsigned char> &buffer)
-    : buffer(buffer), pos(0) {
+BERParser::BERParser(std::string_view buffer) : buffer(buffer), pos(0) {
   if (buffer.size() < 2) {
     std::cerr << "Buffer too small" << std::endl;
     return;
   }
 }
 
+bool BERParser::hasBytes(size_t count) {
+  if (count > buffer.size() - pos) {
+    std::cerr << "Unexpected end of message" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 bool BERParser::getTag(unsigned char &tag) {
+  if (!hasBytes(1)) {
+    return false;
+  }
+
   tag = buffer[pos++];
   return true;
 }
 
-bool BERParser::getLength(unsigned char &length) {
+bool BERParser::getLength(size_t &length) {
+  if (!hasBytes(1)) {
+    return false;
+  }
+
   unsigned char tmpLength = buffer[pos++];
   // Determine if the length is long form
   if (tmpLength & 0x80) {
-    unsigned char lengthBytes = length & 0x7F;
+    unsigned char lengthBytes = tmpLength & 0x7F;
+    length = 0;
 
-    if (lengthBytes > 4) {
-      std::cerr << "Length too long" << std::endl;
+    // Indefinite length is not allowed in LDAP
+    if (lengthBytes == 0 || lengthBytes > 4) {
+      std::cerr << "Unsupported length" << std::endl;
+      return false;
+    }
+
+    if (!hasBytes(lengthBytes)) {
       return false;
     }
 
     // Construct longform length
     while (lengthBytes--) {
-      length = (length << 8) | buffer[pos++];
+      length = (length << 8) | static_cast<unsigned char>(buffer[pos++]);
     }
 
     return true;
@@ -42,15 +64,16 @@ bool BERParser::getLength(unsigned char &length) {
   return true;
 }
 
-bool BERParser::getInteger(unsigned char &integer) {
+bool BERParser::getIntegerValue(unsigned char expectedTag, int32_t &value) {
   unsigned char tag;
-  unsigned char length;
+  size_t length;
   if (!getTag(tag)) {
     return false;
   }
 
-  if (tag != 0x02) {
-    std::cerr << "Expected tag 0x02, got " << std::hex << (int)tag << std::endl;
+  if (tag != expectedTag) {
+    std::cerr << "Expected tag 0x" << std::hex << (int)expectedTag << ", got "
+              << (int)tag << std::dec << std::endl;
     return false;
   }
 
@@ -58,13 +81,32 @@ bool BERParser::getInteger(unsigned char &integer) {
     return false;
   }
 
-  integer = buffer[pos++];
+  if (length == 0 || length > sizeof(value)) {
+    std::cerr << "Unsupported integer length " << length << std::endl;
+    return false;
+  }
+
+  if (!hasBytes(length)) {
+    return false;
+  }
+
+  // Big endian two's complement, the first byte carries the sign
+  uint32_t bits = static_cast<signed char>(buffer[pos++]);
+  while (--length) {
+    bits = (bits << 8) | static_cast<unsigned char>(buffer[pos++]);
+  }
+
+  value = static_cast<int32_t>(bits);
   return true;
 }
 
+bool BERParser::getInteger(int32_t &integer) {
+  return getIntegerValue(0x02, integer);
+}
+
 bool BERParser::getBool(unsigned char &boolean) {
   unsigned char tag;
-  unsigned char length;
+  size_t length;
   if (!getTag(tag)) {
     return false;
   }
@@ -78,33 +120,26 @@ bool BERParser::getBool(unsigned char &boolean) {
     return false;
   }
 
-  boolean = buffer[pos++];
-  return true;
-}
-
-bool BERParser::getEnum(unsigned char &enumeration) {
-  unsigned char tag;
-  unsigned char length;
-  if (!getTag(tag)) {
-    return false;
-  }
-
-  if (tag != 0x0A) {
-    std::cerr << "Expected tag 0x0A, got " << std::hex << (int)tag << std::endl;
+  if (length != 1) {
+    std::cerr << "Expected boolean of one byte" << std::endl;
     return false;
   }
 
-  if (!getLength(length)) {
+  if (!hasBytes(1)) {
     return false;
   }
 
-  enumeration = buffer[pos++];
+  boolean = buffer[pos++];
   return true;
 }
 
-bool BERParser::getOctetString(std::vector<unsigned char> &ostring) {
+bool BERParser::getEnum(int32_t &enumeration) {
+  return getIntegerValue(0x0A, enumeration);
+}
+
+bool BERParser::getOctetString(std::string_view &ostring) {
   unsigned char tag;
-  unsigned char length;
+  size_t length;
 
   if (!getTag(tag)) {
     return false;
@@ -115,21 +150,19 @@ bool BERParser::getOctetString(std::vector<unsigned char> &ostring) {
     return false;
   }
 
-  if (!getLength(length)) {
+  if (!getLength(length) || !hasBytes(length)) {
     return false;
   }
 
-  ostring = std::vector<unsigned char>(buffer.begin() + pos,
-                                       buffer.begin() + pos + length);
-
+  ostring = buffer.substr(pos, length);
   pos += length;
 
   return true;
 }
 
-bool BERParser::getSequence(std::vector<unsigned char> &sequence) {
+bool BERParser::getSequence(std::string_view &sequence) {
   unsigned char tag;
-  unsigned char length;
+  size_t length;
 
   if (!getTag(tag)) {
     return false;
@@ -140,57 +173,85 @@ bool BERParser::getSequence(std::vector<unsigned char> &sequence) {
     return false;
   }
 
-  if (!getLength(length)) {
+  if (!getLength(length) || !hasBytes(length)) {
     return false;
   }
 
-  sequence = std::vector<unsigned char>(buffer.begin() + pos,
-                                        buffer.begin() + pos + length);
-  // pos += length;
+  sequence = buffer.substr(pos, length);
   return true;
 }
 
 bool BERParser::isEnd() { return pos == buffer.size(); }
 
-bool BERParser::getSubstringFilter(SubsType &subs) {
+bool BERParser::countElements(size_t end, size_t &count) {
+  size_t start = pos;
+  count = 0;
+
+  // Hop over the elements, only their headers are read
+  bool valid = true;
+  while (valid && pos < end) {
+    unsigned char tag;
+    size_t length;
+    valid = getTag(tag) && getLength(length) && pos <= end &&
+            length <= end - pos;
+    if (valid) {
+      pos += length;
+      count++;
+    }
+  }
+
+  pos = start;
+  return valid;
+}
+
+bool BERParser::getSubstringFilter(std::string_view sequence,
+                                   SubsType &subs, Arena &arena) {
+  size_t end = pos + sequence.size();
   bool hasInitial = false;
   bool hasFinal = false;
 
-  while (true) {
+  // Room for every element, only the any substrings are stored there
+  size_t elements;
+  if (!countElements(end, elements)) {
+    return false;
+  }
+  subs.any = arena.allocate<std::string_view>(elements);
+  subs.any.count = 0;
+
+  while (pos < end) {
     unsigned char tag;
     if (!getTag(tag)) {
       return false;
     }
 
     if (tag != 0x80 && tag != 0x81 && tag != 0x82) {
-      pos -= 1;
-      break;
+      std::cerr << "Expected substring, got " << std::hex << (int)tag
+                << std::endl;
+      return false;
     }
 
-    unsigned char length;
+    size_t length;
     if (!getLength(length)) {
       return false;
     }
 
+    std::string_view value = buffer.substr(pos, length);
     if (tag == 0x80) {
       if (hasInitial) {
         std::cerr << "Expected only one initial substring filter" << std::endl;
         return false;
       }
 
-      subs.initial =
-          std::string(buffer.begin() + pos, buffer.begin() + pos + length);
+      subs.initial = value;
       hasInitial = true;
     } else if (tag == 0x81) {
-      subs.any.push_back(
-          std::string(buffer.begin() + pos, buffer.begin() + pos + length));
+      subs.any[subs.any.count++] = value;
     } else if (tag == 0x82) {
       if (hasFinal) {
         std::cerr << "Expected only one final substring filter" << std::endl;
         return false;
       }
-      subs.final =
-          std::string(buffer.begin() + pos, buffer.begin() + pos + length);
+      subs.final = value;
       hasFinal = true;
     }
 
@@ -200,52 +261,42 @@ bool BERParser::getSubstringFilter(SubsType &subs) {
   return true;
 }
 
-bool BERParser::getFilter(Filter &filter) {
-  // If following tag is a sequence, we catched attribute list
+bool BERParser::getFilter(Filter &filter, Arena &arena, size_t depth) {
   unsigned char tag;
-  unsigned char length;
+  size_t length;
 
   if (!getTag(tag)) {
     return false;
   }
 
-  if (!getLength(length)) {
+  if (!getLength(length) || !hasBytes(length)) {
     return false;
   }
 
   filter.type = static_cast<FilterType>(tag);
 
-  std::vector<unsigned char> seq;
+  std::string_view seq;
   size_t endOfFilter = pos + length;
 
-  std::vector<unsigned char> tmp;
-
   // Get the filter type
   switch (filter.type) {
-  case FilterType::ALL:
+  case FilterType::Present:
+    // The attribute is the content itself
+    filter.present = buffer.substr(pos, length);
     break;
   case FilterType::EqualityMatch:
-    if (!getOctetString(tmp)) {
-      return false;
-    }
-
-    filter.equalityMatch.type =
-        std::string(tmp.begin(), tmp.end()); // Convert to string
-
-    if (!getOctetString(tmp)) {
+  case FilterType::GreaterOrEqual:
+  case FilterType::LessOrEqual:
+  case FilterType::ApproxMatch:
+    if (!getOctetString(filter.equalityMatch.type) ||
+        !getOctetString(filter.equalityMatch.value)) {
       return false;
     }
-
-    filter.equalityMatch.value =
-        std::string(tmp.begin(), tmp.end()); // Convert to string
-
     break;
   case FilterType::SubstringMatch:
-    if (!getOctetString(tmp)) {
+    if (!getOctetString(filter.substringMatch.type)) {
       return false;
     }
-    filter.substringMatch.type =
-        std::string(tmp.begin(), tmp.end()); // Convert to string
 
     // Parse sequence
     if (!getSequence(seq)) {
@@ -253,29 +304,96 @@ bool BERParser::getFilter(Filter &filter) {
     }
 
     // parse substring filters
-    if (!getSubstringFilter(filter.substringMatch)) {
+    if (!getSubstringFilter(seq, filter.substringMatch, arena)) {
       return false;
     }
 
     break;
   case FilterType::AND:
   case FilterType::OR:
-  case FilterType::NOT:
-    while (pos < endOfFilter) {
-      Filter nestedFilter;
+  case FilterType::NOT: {
+    if (depth >= MAX_FILTER_DEPTH) {
+      return false;
+    }
 
-      if (!getFilter(nestedFilter)) {
+    // The nested filters are counted first, so they fit one allocation
+    size_t count;
+    if (!countElements(endOfFilter, count)) {
+      return false;
+    }
+
+    filter.filters = arena.allocate<Filter>(count);
+    for (size_t i = 0; i < count; ++i) {
+      if (!getFilter(filter.filters[i], arena, depth + 1)) {
+        filter.filters.count = i;
         return false;
-        break;
       }
-
-      filter.filters.push_back(nestedFilter);
     }
     break;
+  }
 
   default:
     break;
   }
 
+  // Skip what was not parsed, such as the contents of an extensible match
+  pos = endOfFilter;
   return true;
 }
+
+size_t BEREncoder::lengthSize(size_t length) {
+  if (length <= 0x7F) {
+    return 1;
+  }
+
+  // Long form, one byte for the count and one per length byte
+  size_t size = 1;
+  for (; length > 0; length >>= 8) {
+    size++;
+  }
+  return size;
+}
+
+size_t BEREncoder::integerSize(int64_t value) {
+  // Grow until the value fits the signed range of the bytes
+  size_t size = 1;
+  while (size < sizeof(value) && (value < -(int64_t(1) << (size * 8 - 1)) ||
+                                  value >= (int64_t(1) << (size * 8 - 1)))) {
+    size++;
+  }
+  return size;
+}
+
+void BEREncoder::putHeader(unsigned char tag, size_t length) {
+  buffer[pos++] = tag;
+
+  if (length <= 0x7F) {
+    buffer[pos++] = static_cast<unsigned char>(length);
+    return;
+  }
+
+  // Long form, number of length bytes first, then big endian
+  size_t bytes = lengthSize(length) - 1;
+  buffer[pos++] = static_cast<unsigned char>(0x80 | bytes);
+  while (bytes--) {
+    buffer[pos++] = static_cast<unsigned char>(length >> (bytes * 8));
+  }
+}
+
+void BEREncoder::putInteger(int64_t value, unsigned char tag) {
+  size_t bytes = integerSize(value);
+  putHeader(tag, bytes);
+  while (bytes--) {
+    buffer[pos++] = static_cast<unsigned char>(value >> (bytes * 8));
+  }
+}
+
+void BEREncoder::putOctetString(std::string_view value) {
+  putHeader(0x04, value.size());
+  putBytes(value.data(), value.size());
+}
+
+void BEREncoder::putBytes(const void *data, size_t size) {
+  memcpy(buffer + pos, data, size);
+  pos += size;
+}
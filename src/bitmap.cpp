@@ -0,0 +1,247 @@
+/**
+ * @file bitmap.cpp
+ * @brief This file contains the Bitmap class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <iterator>
+
+#include "../include/bitmap.h"
+
+#define CONTAINER_WORDS (CONTAINER_BITS / 64)
+
+Bitmap Bitmap::fromSorted(const uint32_t *first, const uint32_t *last) {
+  Bitmap bitmap;
+
+  while (first != last) {
+    Container container;
+    container.key = static_cast<uint16_t>(*first >> 16);
+
+    // Ids of one container are contiguous in the input
+    const uint32_t *end = first;
+    while (end != last && (*end >> 16) == container.key) {
+      ++end;
+    }
+
+    container.cardinality = end - first;
+    if (container.cardinality <= MAX_ARRAY_SIZE) {
+      container.values.reserve(container.cardinality);
+      for (const uint32_t *id = first; id != end; ++id) {
+        container.values.push_back(static_cast<uint16_t>(*id));
+      }
+    } else {
+      container.words.assign(CONTAINER_WORDS, 0);
+      for (const uint32_t *id = first; id != end; ++id) {
+        container.words[(*id & 0xFFFF) / 64] |= 1ULL << (*id % 64);
+      }
+    }
+
+    bitmap.containers.push_back(std::move(container));
+    first = end;
+  }
+
+  return bitmap;
+}
+
+void Bitmap::append(uint32_t id) {
+  uint16_t key = static_cast<uint16_t>(id >> 16);
+  if (containers.empty() || containers.back().key != key) {
+    containers.push_back({key, 0, {}, {}});
+  }
+
+  // The array turns into words once it would outgrow them
+  Container &container = containers.back();
+  container.cardinality++;
+  if (container.words.empty() && container.cardinality <= MAX_ARRAY_SIZE) {
+    container.values.push_back(static_cast<uint16_t>(id));
+    return;
+  }
+  if (container.words.empty()) {
+    container.words = toWords(container);
+    std::vector<uint16_t>().swap(container.values);
+  }
+  container.words[(id & 0xFFFF) / 64] |= 1ULL << (id % 64);
+}
+
+Bitmap Bitmap::range(uint32_t size) {
+  Bitmap bitmap;
+
+  for (uint32_t start = 0; start < size; start += CONTAINER_BITS) {
+    uint32_t count = std::min<uint32_t>(size - start, CONTAINER_BITS);
+
+    std::vector<uint64_t> words(CONTAINER_WORDS, 0);
+    for (uint32_t i = 0; i < count / 64; ++i) {
+      words[i] = ~0ULL;
+    }
+    if (count % 64) {
+      words[count / 64] = (1ULL << (count % 64)) - 1;
+    }
+
+    Container container;
+    container.key = static_cast<uint16_t>(start >> 16);
+    fromWords(std::move(words), container);
+    bitmap.containers.push_back(std::move(container));
+  }
+
+  return bitmap;
+}
+
+size_t Bitmap::cardinality() const {
+  size_t count = 0;
+  for (const auto &container : containers) {
+    count += container.cardinality;
+  }
+  return count;
+}
+
+bool Bitmap::contains(uint32_t id) const {
+  uint16_t key = id >> 16;
+  uint16_t low = id & 0xFFFF;
+
+  auto container = std::lower_bound(
+      containers.begin(), containers.end(), key,
+      [](const Container &a, uint16_t key) { return a.key < key; });
+  if (container == containers.end() || container->key != key) {
+    return false;
+  }
+
+  if (container->words.empty()) {
+    return std::binary_search(container->values.begin(),
+                              container->values.end(), low);
+  }
+  return container->words[low / 64] >> (low % 64) & 1;
+}
+
+Bitmap Bitmap::operator&(const Bitmap &other) const {
+  return combine(other, Operation::And);
+}
+
+Bitmap Bitmap::operator|(const Bitmap &other) const {
+  return combine(other, Operation::Or);
+}
+
+Bitmap Bitmap::operator-(const Bitmap &other) const {
+  return combine(other, Operation::AndNot);
+}
+
+Bitmap Bitmap::combine(const Bitmap &other, Operation operation) const {
+  Bitmap result;
+  size_t i = 0;
+  size_t j = 0;
+
+  // Merge the containers by key
+  while (i < containers.size() || j < other.containers.size()) {
+    bool onlyThis = j == other.containers.size() ||
+                    (i < containers.size() &&
+                     containers[i].key < other.containers[j].key);
+    if (onlyThis) {
+      if (operation != Operation::And) {
+        result.containers.push_back(containers[i]);
+      }
+      ++i;
+    } else if (i == containers.size() ||
+               other.containers[j].key < containers[i].key) {
+      if (operation == Operation::Or) {
+        result.containers.push_back(other.containers[j]);
+      }
+      ++j;
+    } else {
+      Container container;
+      if (combineContainers(containers[i], other.containers[j], operation,
+                            container)) {
+        result.containers.push_back(std::move(container));
+      }
+      ++i;
+      ++j;
+    }
+  }
+
+  return result;
+}
+
+bool Bitmap::combineContainers(const Container &a, const Container &b,
+                               Operation operation, Container &result) {
+  result.key = a.key;
+
+  // Two arrays are merged directly
+  if (a.words.empty() && b.words.empty()) {
+    auto out = std::back_inserter(result.values);
+    switch (operation) {
+    case Operation::And:
+      std::set_intersection(a.values.begin(), a.values.end(), b.values.begin(),
+                            b.values.end(), out);
+      break;
+    case Operation::Or:
+      std::set_union(a.values.begin(), a.values.end(), b.values.begin(),
+                     b.values.end(), out);
+      break;
+    case Operation::AndNot:
+      std::set_difference(a.values.begin(), a.values.end(), b.values.begin(),
+                          b.values.end(), out);
+      break;
+    }
+
+    result.cardinality = result.values.size();
+    if (result.cardinality > MAX_ARRAY_SIZE) {
+      fromWords(toWords(result), result);
+    }
+    return result.cardinality > 0;
+  }
+
+  // Anything involving a dense container is done word by word
+  std::vector<uint64_t> words = toWords(a);
+  std::vector<uint64_t> otherWords = toWords(b);
+  for (size_t i = 0; i < CONTAINER_WORDS; ++i) {
+    switch (operation) {
+    case Operation::And:
+      words[i] &= otherWords[i];
+      break;
+    case Operation::Or:
+      words[i] |= otherWords[i];
+      break;
+    case Operation::AndNot:
+      words[i] &= ~otherWords[i];
+      break;
+    }
+  }
+
+  fromWords(std::move(words), result);
+  return result.cardinality > 0;
+}
+
+std::vector<uint64_t> Bitmap::toWords(const Container &container) {
+  if (!container.words.empty()) {
+    return container.words;
+  }
+
+  std::vector<uint64_t> words(CONTAINER_WORDS, 0);
+  for (uint16_t low : container.values) {
+    words[low / 64] |= 1ULL << (low % 64);
+  }
+  return words;
+}
+
+void Bitmap::fromWords(std::vector<uint64_t> &&words, Container &container) {
+  container.cardinality = 0;
+  for (uint64_t word : words) {
+    container.cardinality += __builtin_popcountll(word);
+  }
+
+  container.values.clear();
+  container.words.clear();
+
+  if (container.cardinality > MAX_ARRAY_SIZE) {
+    container.words = std::move(words);
+    return;
+  }
+
+  container.values.reserve(container.cardinality);
+  for (size_t i = 0; i < words.size(); ++i) {
+    uint64_t word = words[i];
+    while (word) {
+      container.values.push_back(
+          static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+      word &= word - 1;
+    }
+  }
+}
@@ -0,0 +1,255 @@
+/**
+ * @file cache.cpp
+ * @brief This file contains the ResultCache class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <functional>
+
+#include "../include/cache.h"
+
+// Bookkeeping bytes of one cached result besides its key and ids
+#define RESULT_ENTRY_OVERHEAD 128
+
+/**
+ * @brief Append a length prefixed string to the key
+ * @param value The string
+ * @param key The key being built
+ */
+static void appendString(std::string_view value, std::string &key) {
+  uint32_t length = value.size();
+  key.append(reinterpret_cast<const char *>(&length), sizeof(length));
+  key.append(value);
+}
+
+/**
+ * @brief Append the canonical form of a filter to the key
+ * @param filter The filter
+ * @param key The key being built
+ */
+static void appendFilter(const Filter &filter, std::string &key) {
+  key.push_back(static_cast<char>(filter.type));
+
+  switch (filter.type) {
+  case FilterType::AND:
+  case FilterType::OR: {
+    // Sorted and without repeats, (&(a)(b)) and (&(b)(a)(a)) match the same
+    std::vector<std::string> nested(filter.filters.size());
+    for (size_t i = 0; i < nested.size(); ++i) {
+      appendFilter(filter.filters[i], nested[i]);
+    }
+    std::sort(nested.begin(), nested.end());
+    nested.erase(std::unique(nested.begin(), nested.end()), nested.end());
+
+    uint32_t count = nested.size();
+    key.append(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (const auto &part : nested) {
+      appendString(part, key);
+    }
+    break;
+  }
+  case FilterType::NOT:
+    for (const auto &nested : filter.filters) {
+      appendFilter(nested, key);
+    }
+    break;
+  default: {
+    // Leaves keep every string, unused ones are empty
+    appendString(filter.equalityMatch.type, key);
+    appendString(filter.equalityMatch.value, key);
+    appendString(filter.substringMatch.type, key);
+    appendString(filter.substringMatch.initial, key);
+    uint32_t count = filter.substringMatch.any.size();
+    key.append(reinterpret_cast<const char *>(&count), sizeof(count));
+    for (auto part : filter.substringMatch.any) {
+      appendString(part, key);
+    }
+    appendString(filter.substringMatch.final, key);
+    appendString(filter.present, key);
+    break;
+  }
+  }
+}
+
+void ResultCache::makeKey(const Filter &filter, int32_t sizeLimit,
+                          std::string &key) {
+  appendFilter(filter, key);
+
+  int32_t limit = std::max<int32_t>(sizeLimit, 0);
+  key.append(reinterpret_cast<const char *>(&limit), sizeof(limit));
+}
+
+SearchFlight::SearchFlight(uint64_t version)
+    : version(version), result(std::make_shared<CachedResult>()) {}
+
+void SearchFlight::publish(const std::vector<uint32_t> &ids) {
+  std::lock_guard<std::mutex> lock(mutex);
+  result->ids.insert(result->ids.end(), ids.begin(), ids.end());
+  changed.notify_all();
+}
+
+void SearchFlight::finish(bool sizeLimitReached) {
+  std::lock_guard<std::mutex> lock(mutex);
+  result->sizeLimitReached = sizeLimitReached;
+  state = State::Done;
+  changed.notify_all();
+}
+
+void SearchFlight::abandon() {
+  std::lock_guard<std::mutex> lock(mutex);
+  state = State::Abandoned;
+  changed.notify_all();
+}
+
+void SearchFlight::join() {
+  std::lock_guard<std::mutex> lock(mutex);
+  readerCount++;
+}
+
+SearchFlight::State SearchFlight::read(size_t from,
+                                       std::vector<uint32_t> &chunk,
+                                       bool &sizeLimitReached) {
+  std::unique_lock<std::mutex> lock(mutex);
+  changed.wait(lock, [&]() {
+    return result->ids.size() > from || state != State::Running;
+  });
+
+  chunk.assign(result->ids.begin() + from, result->ids.end());
+  sizeLimitReached = result->sizeLimitReached;
+  return state;
+}
+
+size_t SearchFlight::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return result->ids.size();
+}
+
+size_t SearchFlight::readers() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return readerCount;
+}
+
+ResultCache::ResultCache(size_t capacity)
+    : shardCapacity(capacity / RESULT_CACHE_SHARDS) {}
+
+ResultCache::Shard &ResultCache::getShard(const std::string &key) {
+  return shards[std::hash<std::string>()(key) % RESULT_CACHE_SHARDS];
+}
+
+bool ResultCache::fits(size_t count) const {
+  return count * sizeof(uint32_t) + RESULT_ENTRY_OVERHEAD <= shardCapacity;
+}
+
+bool ResultCache::refresh(Shard &shard, uint64_t version) {
+  if (version > shard.version) {
+    shard.lookup.clear();
+    shard.entries.clear();
+    shard.size = 0;
+    shard.version = version;
+  }
+
+  // A search still reading an older version neither hits nor adds results
+  return version == shard.version;
+}
+
+void ResultCache::land(Shard &shard, const std::string &key,
+                       const std::shared_ptr<SearchFlight> &flight) {
+  // A newer flight may have replaced it already
+  auto running = shard.flights.find(key);
+  if (running != shard.flights.end() && running->second == flight) {
+    shard.flights.erase(running);
+  }
+}
+
+CacheLookup ResultCache::find(const std::string &key, uint64_t version) {
+  Shard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  CacheLookup found;
+
+  // A search still reading an older version runs on its own
+  if (!refresh(shard, version)) {
+    missCount.fetch_add(1);
+    return found;
+  }
+
+  auto cached = shard.lookup.find(key);
+  if (cached != shard.lookup.end()) {
+    // Move to the front, the iterators stay valid
+    shard.entries.splice(shard.entries.begin(), shard.entries, cached->second);
+    hitCount.fetch_add(1);
+    found.result = cached->second->result;
+    return found;
+  }
+
+  // Readers join under the shard lock, so release sees every one of them
+  auto running = shard.flights.find(key);
+  if (running != shard.flights.end() &&
+      running->second->getVersion() == version) {
+    sharedCount.fetch_add(1);
+    found.flight = running->second;
+    found.flight->join();
+    return found;
+  }
+
+  // Either nothing runs or a search of an older version, which is replaced
+  missCount.fetch_add(1);
+  found.flight = std::make_shared<SearchFlight>(version);
+  found.leading = true;
+  shard.flights[key] = found.flight;
+  return found;
+}
+
+void ResultCache::complete(const std::string &key,
+                           const std::shared_ptr<SearchFlight> &flight,
+                           bool sizeLimitReached) {
+  flight->finish(sizeLimitReached);
+
+  std::shared_ptr<const CachedResult> result = flight->getResult();
+  size_t size = key.size() + result->ids.size() * sizeof(uint32_t) +
+                RESULT_ENTRY_OVERHEAD;
+
+  Shard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  land(shard, key, flight);
+
+  // Another search may have added the same result in the meantime
+  if (size > shardCapacity || !refresh(shard, flight->getVersion()) ||
+      shard.lookup.count(key) != 0) {
+    return;
+  }
+
+  // Drop the least recently used results until the new one fits
+  while (shard.size + size > shardCapacity) {
+    const Entry &last = shard.entries.back();
+    shard.size -= last.size;
+    shard.lookup.erase(last.key);
+    shard.entries.pop_back();
+  }
+
+  shard.entries.push_front(Entry{key, std::move(result), size});
+  shard.lookup.emplace(shard.entries.front().key, shard.entries.begin());
+  shard.size += size;
+}
+
+void ResultCache::abandon(const std::string &key,
+                          const std::shared_ptr<SearchFlight> &flight) {
+  Shard &shard = getShard(key);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    land(shard, key, flight);
+  }
+  flight->abandon();
+}
+
+bool ResultCache::release(const std::string &key,
+                          const std::shared_ptr<SearchFlight> &flight) {
+  Shard &shard = getShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (flight->readers() > 0) {
+    return false;
+  }
+
+  land(shard, key, flight);
+  flight->abandon();
+  return true;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file directory.cpp
+ * @brief This file contains the Directory class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../include/directory.h"
+
+bool Directory::load(const std::string &filename, size_t threads) {
+  if (!file.open(filename)) {
+    return false;
+  }
+
+  if (isSnapshot(file.data(), file.size())) {
+    if (!loadSnapshot()) {
+      std::cerr << "Error: Invalid snapshot " << filename << std::endl;
+      return false;
+    }
+  } else {
+    readCSV(file.data(), file.size(), entries, threads);
+
+    // Filters are matched ignoring case against the folded shadows, the
+    // responses are encoded from the stored values
+    for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+      buildIndexes(i);
+    }
+
+    encodings.build(entries);
+
+    // The columns hold copies of the values, the file is not read again
+    file.close();
+  }
+
+  allIds = Bitmap::range(entries.size());
+
+  return true;
+}
+
+bool Directory::save(const std::string &filename) const {
+  // Same order as loadSnapshot reads the sections
+  SnapshotWriter writer;
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    entries.columns[i].save(writer);
+    entries.folded[i].saveFolded(writer);
+    equalityIndexes[i].save(writer);
+    trigramIndexes[i].save(writer);
+    prefixIndexes[i].save(writer);
+  }
+  encodings.save(writer);
+
+  return writer.write(filename, ATTRIBUTE_COUNT, entries.size());
+}
+
+bool Directory::loadSnapshot() {
+  SnapshotReader reader;
+  if (!reader.open(file.data(), file.size()) ||
+      reader.attributes() != ATTRIBUTE_COUNT) {
+    return false;
+  }
+
+  // Values and ids are trusted, only the layout is checked
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    if (!entries.columns[i].load(reader) ||
+        entries.columns[i].size() != reader.entries() ||
+        !entries.folded[i].loadFolded(entries.columns[i], reader) ||
+        !equalityIndexes[i].load(reader) || !trigramIndexes[i].load(reader) ||
+        !prefixIndexes[i].load(reader) ||
+        prefixIndexes[i].size() != reader.entries()) {
+      return false;
+    }
+  }
+
+  return encodings.load(reader, reader.entries());
+}
+
+void Directory::buildIndexes(size_t attribute) {
+  entries.folded[attribute].fold(entries.columns[attribute]);
+  equalityIndexes[attribute].build(entries.folded[attribute]);
+  trigramIndexes[attribute].build(entries.folded[attribute]);
+  prefixIndexes[attribute].build(entries.folded[attribute]);
+}
+
+bool Directory::findEqual(const EqType &eqMatch, PostingList &result) const {
+  Attribute attribute;
+  if (!getAttributeType(eqMatch.type, attribute)) {
+    return false;
+  }
+
+  result = getEqualityIndex(attribute).find(
+      eqMatch.value, entries.getFoldedColumn(attribute));
+  return true;
+}
+
+bool Directory::findSubstringCandidates(
+    const SubsType &subsMatch, std::vector<uint32_t> &candidates) const {
+  Attribute attribute;
+  if (!getAttributeType(subsMatch.type, attribute)) {
+    return false;
+  }
+
+  const TrigramIndex &index = trigramIndexes[static_cast<size_t>(attribute)];
+
+  std::vector<std::string_view> fragments(subsMatch.any.begin(),
+                                          subsMatch.any.end());
+  fragments.push_back(subsMatch.initial);
+  fragments.push_back(subsMatch.final);
+
+  // Entry must contain every fragment, intersect their candidates
+  bool found = false;
+  std::vector<uint32_t> fragmentCandidates;
+  std::vector<uint32_t> intersection;
+
+  for (const auto &fragment : fragments) {
+    if (!index.findCandidates(fragment, fragmentCandidates)) {
+      continue;
+    }
+
+    if (!found) {
+      candidates.swap(fragmentCandidates);
+      found = true;
+    } else {
+      intersection.clear();
+      std::set_intersection(candidates.begin(), candidates.end(),
+                            fragmentCandidates.begin(),
+                            fragmentCandidates.end(),
+                            std::back_inserter(intersection));
+      candidates.swap(intersection);
+    }
+  }
+
+  return found;
+}
+
+bool Directory::findPrefix(const SubsType &subsMatch,
+                           PostingList &result) const {
+  Attribute attribute;
+  if (subsMatch.initial.empty() || !subsMatch.any.empty() ||
+      !subsMatch.final.empty() ||
+      !getAttributeType(subsMatch.type, attribute)) {
+    return false;
+  }
+
+  result = prefixIndexes[static_cast<size_t>(attribute)].find(
+      subsMatch.initial, entries.getFoldedColumn(attribute));
+  return true;
+}
+
+bool Directory::findRange(const EqType &assertion, FilterType type,
+                          PostingList &matching, PostingList &rest) const {
+  Attribute attribute;
+  if (!getAttributeType(assertion.type, attribute)) {
+    return false;
+  }
+
+  // Values equal to the bound match both ways
+  const PrefixIndex &index = prefixIndexes[static_cast<size_t>(attribute)];
+  const Column &column = entries.getFoldedColumn(attribute);
+  if (type == FilterType::GreaterOrEqual) {
+    index.split(assertion.value, false, column, rest, matching);
+  } else {
+    index.split(assertion.value, true, column, matching, rest);
+  }
+  return true;
+}
+
+size_t Directory::memoryUsage() const {
+  size_t usage = sizeof(*this) + file.size();
+
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    usage += entries.columns[i].memoryUsage();
+    usage += entries.folded[i].memoryUsage();
+    usage += equalityIndexes[i].memoryUsage();
+    usage += trigramIndexes[i].memoryUsage();
+    usage += prefixIndexes[i].memoryUsage();
+  }
+  usage += encodings.memoryUsage();
+
+  return usage;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file encoding.cpp
+ * @brief This file contains the EntryEncodings class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <vector>
+
+#include "../include/ber.h"
+#include "../include/encoding.h"
+
+// Every DN is the uid of the entry
+#define DN_PREFIX "uid="
+#define DN_PREFIX_SIZE 4
+
+/**
+ * @brief Get the size of a PartialAttribute holding one value
+ * @param type The type of the attribute
+ * @param value The value of the attribute
+ */
+static size_t attributeSize(std::string_view type, std::string_view value) {
+  size_t valuesSize = BEREncoder::tlvSize(BEREncoder::tlvSize(value.size()));
+  return BEREncoder::tlvSize(BEREncoder::tlvSize(type.size()) + valuesSize);
+}
+
+/**
+ * @brief Put a PartialAttribute holding one value
+ * @param encoder The encoder to write with
+ * @param type The type of the attribute
+ * @param value The value of the attribute
+ */
+static void putAttribute(BEREncoder &encoder, std::string_view type,
+                         std::string_view value) {
+  size_t valueSize = BEREncoder::tlvSize(value.size());
+
+  // Attribute SEQUENCE
+  encoder.putHeader(0x30,
+                    BEREncoder::tlvSize(type.size()) +
+                        BEREncoder::tlvSize(valueSize));
+  encoder.putOctetString(type);
+
+  // Attribute value SET
+  encoder.putHeader(0x31, valueSize);
+  encoder.putOctetString(value);
+}
+
+void EntryEncodings::build(const EntryTable &entries) {
+  const Column &uids = entries.getColumn(Attribute::UID);
+  const Column &cns = entries.getColumn(Attribute::CN);
+  const Column &mails = entries.getColumn(Attribute::MAIL);
+
+  // Size every body first, then encode them all into one buffer
+  std::vector<uint64_t> starts(entries.size() + 1, 0);
+  for (uint32_t id = 0; id < entries.size(); ++id) {
+    size_t attributesSize =
+        attributeSize("cn", cns.get(id)) + attributeSize("mail", mails.get(id));
+    starts[id + 1] = starts[id] +
+                     BEREncoder::tlvSize(DN_PREFIX_SIZE + uids.get(id).size()) +
+                     BEREncoder::tlvSize(attributesSize);
+  }
+
+  std::vector<char> encoded(starts[entries.size()]);
+  for (uint32_t id = 0; id < entries.size(); ++id) {
+    BEREncoder encoder(reinterpret_cast<unsigned char *>(encoded.data()) +
+                       starts[id]);
+
+    // ObjectName (DN)
+    std::string_view uid = uids.get(id);
+    encoder.putHeader(0x04, DN_PREFIX_SIZE + uid.size());
+    encoder.putBytes(DN_PREFIX, DN_PREFIX_SIZE);
+    encoder.putBytes(uid.data(), uid.size());
+
+    // Attributes SEQUENCE
+    encoder.putHeader(0x30, attributeSize("cn", cns.get(id)) +
+                                attributeSize("mail", mails.get(id)));
+    putAttribute(encoder, "cn", cns.get(id));
+    putAttribute(encoder, "mail", mails.get(id));
+  }
+
+  bytes = Array<char>(std::move(encoded));
+  offsets = Array<uint64_t>(std::move(starts));
+}
+
+void EntryEncodings::save(SnapshotWriter &writer) const {
+  writer.add(bytes);
+  writer.add(offsets);
+}
+
+bool EntryEncodings::load(SnapshotReader &reader, uint64_t entries) {
+  return reader.read(bytes) && reader.read(offsets) &&
+         offsets.size() == entries + 1 &&
+         offsets[entries] == bytes.size();
+}
+
+size_t EntryEncodings::memoryUsage() const {
+  return bytes.memoryUsage() + offsets.memoryUsage();
+}
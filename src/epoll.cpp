@@ -0,0 +1,208 @@
+/**
+ * @file epoll.cpp
+ * @brief This file contains the EpollServer class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#include "../include/epoll.h"
+#include "../include/message.h"
+
+static bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// Client sockets are one-shot, only one worker serves a connection at a time
+static bool armConnection(Connection *connection, int op, uint32_t events) {
+  epoll_event event = {};
+  event.events = events | EPOLLONESHOT;
+  event.data.ptr = connection;
+  return epoll_ctl(connection->epollFd, op, connection->fd, &event) != -1;
+}
+
+EpollServer::EpollServer(int listenFd, const DirectoryStore &store,
+                         size_t reactors, size_t workers, size_t watermark)
+    : listenFd(listenFd), store(store),
+      reactors(reactors == 0 ? 1 : reactors), watermark(watermark),
+      pool(workers) {}
+
+void EpollServer::run() {
+  if (!setNonBlocking(listenFd)) {
+    std::cerr << "Error: Failed to set listening socket non-blocking"
+              << std::endl;
+    return;
+  }
+
+  std::cout << "Epoll mode: " << reactors << " reactors, " << pool.size()
+            << " workers" << std::endl;
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < reactors; ++i) {
+    int epollFd = epoll_create1(0);
+    if (epollFd == -1) {
+      std::cerr << "Error: Failed to create epoll instance" << std::endl;
+      break;
+    }
+
+    // Every reactor listens, EPOLLEXCLUSIVE wakes only one of them
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == -1) {
+      std::cerr << "Error: Failed to register listening socket" << std::endl;
+      close(epollFd);
+      break;
+    }
+
+    threads.emplace_back(&EpollServer::reactorLoop, this, epollFd);
+  }
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void EpollServer::reactorLoop(int epollFd) {
+  epoll_event events[MAX_EVENTS];
+
+  while (1) {
+    int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+    if (count == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Error: Failed to wait for events" << std::endl;
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      // Listening socket is registered without a connection
+      if (events[i].data.ptr == nullptr) {
+        acceptConnections(epollFd);
+        continue;
+      }
+
+      auto connection = static_cast<Connection *>(events[i].data.ptr);
+      pool.submit([this, connection] { serveConnection(connection); });
+    }
+  }
+
+  close(epollFd);
+}
+
+void EpollServer::acceptConnections(int epollFd) {
+  while (1) {
+    sockaddr_in6 clientAddr;
+    socklen_t clientAddrLen = sizeof(clientAddr);
+    int clientSockfd = accept4(listenFd, (sockaddr *)&clientAddr,
+                               &clientAddrLen, SOCK_NONBLOCK);
+    if (clientSockfd == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        std::cerr << "Error: Failed to accept connection" << std::endl;
+      }
+      return;
+    }
+
+    char host[NI_MAXHOST];
+    char service[NI_MAXSERV];
+    if (getnameinfo((sockaddr *)&clientAddr, clientAddrLen, host, NI_MAXHOST,
+                    service, NI_MAXSERV,
+                    NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
+      std::cout << "Connection from " << host << ":" << service << std::endl;
+    }
+
+    auto connection = new Connection{clientSockfd, epollFd, {},
+                                     OutputBuffer(clientSockfd, watermark)};
+    if (!armConnection(connection, EPOLL_CTL_ADD, EPOLLIN | EPOLLRDHUP)) {
+      std::cerr << "Error: Failed to register connection" << std::endl;
+      close(clientSockfd);
+      delete connection;
+    }
+  }
+}
+
+void EpollServer::handleRequests(Connection *connection) {
+  OutputBuffer &output = connection->output;
+
+  // Requests handled together are served from the same directory version,
+  // an unbind or an invalid request closes the connection after the
+  // responses before it are sent
+  DirectoryReader directory = store.acquire();
+  if (!handleReceivedData(connection->framer, output, *directory)) {
+    connection->closing = true;
+  }
+
+  // Queued and deferred responses may point into the version, it has to
+  // outlive them
+  if (!output.empty()) {
+    output.hold(directory.share());
+  }
+
+  // Reading stops while the client does not take the responses
+  connection->paused = output.full();
+}
+
+void EpollServer::serveConnection(Connection *connection) {
+  OutputBuffer &output = connection->output;
+
+  // Responses the socket did not take before go first, then the requests
+  // left unhandled while the output was full, unless an unbind or an
+  // invalid request came before them
+  bool open = output.flush();
+  if (open && connection->paused && !connection->closing && !output.full()) {
+    handleRequests(connection);
+  }
+
+  // Drain the socket, the connection is disarmed until we rearm it
+  std::vector<unsigned char> buffer(BUFFER_SIZE);
+  while (open && !connection->closing && !connection->paused) {
+    ssize_t bytesReceived =
+        recv(connection->fd, buffer.data(), BUFFER_SIZE, 0);
+
+    if (bytesReceived == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      } else if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Error: Failed to read request" << std::endl;
+      open = false;
+    } else if (bytesReceived == 0) {
+      std::cout << "Client disconnected" << std::endl;
+      connection->closing = true;
+    } else {
+      connection->framer.append(buffer.data(), bytesReceived);
+      handleRequests(connection);
+    }
+  }
+
+  if (output.failed() || (connection->closing && output.empty())) {
+    open = false;
+  }
+
+  // Wait for requests unless paused, and for room in the send buffer while
+  // responses are queued
+  if (open) {
+    uint32_t events = connection->closing || connection->paused
+                          ? 0
+                          : EPOLLIN | EPOLLRDHUP;
+    if (!output.empty()) {
+      events |= EPOLLOUT;
+    }
+    if (armConnection(connection, EPOLL_CTL_MOD, events)) {
+      return;
+    }
+  }
+
+  epoll_ctl(connection->epollFd, EPOLL_CTL_DEL, connection->fd, nullptr);
+  close(connection->fd);
+  delete connection;
+}
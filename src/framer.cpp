@@ -0,0 +1,75 @@
+/**
+ * @file framer.cpp
+ * @brief This file contains the MessageFramer class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <iostream>
+
+#include "../include/framer.h"
+
+void MessageFramer::append(const unsigned char *data, size_t size) {
+  // Drop the consumed bytes before growing the buffer, the messages handed
+  // out so far are no longer used
+  if (start > 0) {
+    buffer.erase(buffer.begin(), buffer.begin() + start);
+    start = 0;
+  }
+
+  buffer.insert(buffer.end(), data, data + size);
+}
+
+FrameStatus MessageFramer::next(std::string_view &pdu) {
+  size_t available = buffer.size() - start;
+  const unsigned char *data = buffer.data() + start;
+
+  // Tag and the first length byte
+  if (available < 2) {
+    return FrameStatus::Incomplete;
+  }
+
+  // Every LDAP message is a SEQUENCE
+  if (data[0] != 0x30) {
+    std::cerr << "Expected tag 0x30, got " << std::hex << (int)data[0]
+              << std::dec << std::endl;
+    return FrameStatus::Invalid;
+  }
+
+  size_t headerSize = 2;
+  size_t length = data[1];
+
+  // Determine if the length is long form
+  if (length & 0x80) {
+    size_t lengthBytes = length & 0x7F;
+
+    if (lengthBytes == 0 || lengthBytes > 4) {
+      std::cerr << "Unsupported message length" << std::endl;
+      return FrameStatus::Invalid;
+    }
+
+    headerSize += lengthBytes;
+    if (available < headerSize) {
+      return FrameStatus::Incomplete;
+    }
+
+    // Construct longform length
+    length = 0;
+    for (size_t i = 0; i < lengthBytes; ++i) {
+      length = (length << 8) | data[2 + i];
+    }
+  }
+
+  if (length > MAX_PDU_SIZE) {
+    std::cerr << "Message too long" << std::endl;
+    return FrameStatus::Invalid;
+  }
+
+  if (available < headerSize + length) {
+    return FrameStatus::Incomplete;
+  }
+
+  pdu = std::string_view(reinterpret_cast<const char *>(data),
+                         headerSize + length);
+  start += headerSize + length;
+
+  return FrameStatus::Complete;
+}
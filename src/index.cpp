@@ -0,0 +1,310 @@
+/**
+ * @file index.cpp
+ * @brief This file contains the attribute indexes implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+#include "../include/index.h"
+
+uint64_t hashString(const char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void EqualityIndex::build(const Column &column) {
+  // Group the entry ids by value, groups are numbered by first occurrence
+  std::unordered_map<std::string_view, uint32_t> groupOf;
+  std::vector<uint32_t> groupSizes;
+  std::vector<uint32_t> entryGroups(column.size());
+
+  for (uint32_t id = 0; id < column.size(); ++id) {
+    std::string_view value = column.get(id);
+    auto inserted = groupOf.emplace(value, groupSizes.size());
+    if (inserted.second) {
+      groupSizes.push_back(0);
+    }
+    entryGroups[id] = inserted.first->second;
+    groupSizes[entryGroups[id]]++;
+  }
+
+  std::vector<uint32_t> groupOffsets(groupSizes.size() + 1, 0);
+  for (size_t group = 0; group < groupSizes.size(); ++group) {
+    groupOffsets[group + 1] = groupOffsets[group] + groupSizes[group];
+  }
+
+  // Ids are visited in order, so every group ends up sorted
+  std::vector<uint32_t> groupPostings(column.size());
+  std::vector<uint32_t> fill(groupOffsets.begin(), groupOffsets.end() - 1);
+  for (uint32_t id = 0; id < column.size(); ++id) {
+    groupPostings[fill[entryGroups[id]]++] = id;
+  }
+
+  // Keep the table at most half full
+  size_t capacity = 1;
+  while (capacity < groupSizes.size() * 2) {
+    capacity <<= 1;
+  }
+  std::vector<uint32_t> tableSlots(capacity, 0);
+  std::vector<uint32_t> tableHashes(capacity, 0);
+
+  for (const auto &group : groupOf) {
+    uint64_t hash = hashString(group.first.data(), group.first.size());
+    size_t slot = hash & (capacity - 1);
+    while (tableSlots[slot] != 0) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+    tableSlots[slot] = group.second + 1;
+    tableHashes[slot] = static_cast<uint32_t>(hash);
+  }
+
+  slots = Array<uint32_t>(std::move(tableSlots));
+  slotHashes = Array<uint32_t>(std::move(tableHashes));
+  offsets = Array<uint32_t>(std::move(groupOffsets));
+  postings = Array<uint32_t>(std::move(groupPostings));
+}
+
+PostingList EqualityIndex::find(std::string_view value,
+                                const Column &column) const {
+  PostingList result;
+  if (slots.empty()) {
+    return result;
+  }
+
+  uint64_t hash = hashString(value.data(), value.size());
+  size_t mask = slots.size() - 1;
+
+  for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+    if (slotHashes[slot] != static_cast<uint32_t>(hash)) {
+      continue;
+    }
+
+    // Compare against the first entry of the group
+    uint32_t group = slots[slot] - 1;
+    uint32_t id = postings[offsets[group]];
+    if (column.get(id) == value) {
+      result.first = postings.data() + offsets[group];
+      result.last = postings.data() + offsets[group + 1];
+      break;
+    }
+  }
+
+  return result;
+}
+
+void EqualityIndex::save(SnapshotWriter &writer) const {
+  writer.add(slots);
+  writer.add(slotHashes);
+  writer.add(offsets);
+  writer.add(postings);
+}
+
+bool EqualityIndex::load(SnapshotReader &reader) {
+  if (!reader.read(slots) || !reader.read(slotHashes) ||
+      !reader.read(offsets) || !reader.read(postings)) {
+    return false;
+  }
+
+  // Lookups mask the hash with the table size
+  return (slots.size() & (slots.size() - 1)) == 0 &&
+         slotHashes.size() == slots.size() && !offsets.empty() &&
+         offsets[offsets.size() - 1] == postings.size();
+}
+
+size_t EqualityIndex::memoryUsage() const {
+  return slots.memoryUsage() + slotHashes.memoryUsage() +
+         offsets.memoryUsage() + postings.memoryUsage();
+}
+
+static uint32_t packTrigram(const char *data) {
+  return static_cast<uint32_t>(static_cast<unsigned char>(data[0])) << 16 |
+         static_cast<uint32_t>(static_cast<unsigned char>(data[1])) << 8 |
+         static_cast<uint32_t>(static_cast<unsigned char>(data[2]));
+}
+
+void TrigramIndex::build(const Column &column) {
+  // Number the distinct trigrams and remember them for every entry
+  std::unordered_map<uint32_t, uint32_t> groupOf;
+  std::vector<uint32_t> groupTrigrams;
+  std::vector<uint32_t> groupSizes;
+  std::vector<uint32_t> entryGroups;
+  std::vector<uint32_t> entryOffsets(column.size() + 1, 0);
+
+  for (uint32_t id = 0; id < column.size(); ++id) {
+    std::string_view value = column.get(id);
+    size_t first = entryGroups.size();
+
+    for (size_t i = 0; i + 3 <= value.size(); ++i) {
+      uint32_t trigram = packTrigram(value.data() + i);
+      auto inserted = groupOf.emplace(trigram, groupTrigrams.size());
+      if (inserted.second) {
+        groupTrigrams.push_back(trigram);
+        groupSizes.push_back(0);
+      }
+      entryGroups.push_back(inserted.first->second);
+    }
+
+    // Every trigram counts once per entry
+    std::sort(entryGroups.begin() + first, entryGroups.end());
+    entryGroups.erase(
+        std::unique(entryGroups.begin() + first, entryGroups.end()),
+        entryGroups.end());
+    for (size_t i = first; i < entryGroups.size(); ++i) {
+      groupSizes[entryGroups[i]]++;
+    }
+    entryOffsets[id + 1] = entryGroups.size();
+  }
+
+  // Lay the groups out in trigram order for binary search
+  std::vector<uint32_t> order(groupTrigrams.size());
+  for (uint32_t group = 0; group < order.size(); ++group) {
+    order[group] = group;
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return groupTrigrams[a] < groupTrigrams[b];
+  });
+
+  std::vector<uint32_t> sortedTrigrams(order.size());
+  std::vector<uint32_t> groupOffsets(order.size() + 1, 0);
+  std::vector<uint32_t> fill(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    sortedTrigrams[i] = groupTrigrams[order[i]];
+    groupOffsets[i + 1] = groupOffsets[i] + groupSizes[order[i]];
+    fill[order[i]] = groupOffsets[i];
+  }
+
+  // Ids are visited in order, so every group ends up sorted
+  std::vector<uint32_t> groupPostings(entryGroups.size());
+  for (uint32_t id = 0; id < column.size(); ++id) {
+    for (size_t i = entryOffsets[id]; i < entryOffsets[id + 1]; ++i) {
+      groupPostings[fill[entryGroups[i]]++] = id;
+    }
+  }
+
+  trigrams = Array<uint32_t>(std::move(sortedTrigrams));
+  offsets = Array<uint32_t>(std::move(groupOffsets));
+  postings = Array<uint32_t>(std::move(groupPostings));
+}
+
+PostingList TrigramIndex::find(uint32_t trigram) const {
+  PostingList result;
+
+  auto it = std::lower_bound(trigrams.begin(), trigrams.end(), trigram);
+  if (it != trigrams.end() && *it == trigram) {
+    size_t group = it - trigrams.begin();
+    result.first = postings.data() + offsets[group];
+    result.last = postings.data() + offsets[group + 1];
+  }
+
+  return result;
+}
+
+bool TrigramIndex::findCandidates(std::string_view fragment,
+                                  std::vector<uint32_t> &candidates) const {
+  if (fragment.size() < 3) {
+    return false;
+  }
+
+  // Look up every trigram of the fragment, intersect the shortest first
+  std::vector<PostingList> lists;
+  for (size_t i = 0; i + 3 <= fragment.size(); ++i) {
+    lists.push_back(find(packTrigram(fragment.data() + i)));
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const PostingList &a, const PostingList &b) {
+              return a.size() < b.size();
+            });
+
+  candidates.assign(lists[0].begin(), lists[0].end());
+  std::vector<uint32_t> intersection;
+
+  for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+    intersection.clear();
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          lists[i].begin(), lists[i].end(),
+                          std::back_inserter(intersection));
+    candidates.swap(intersection);
+  }
+
+  return true;
+}
+
+void TrigramIndex::save(SnapshotWriter &writer) const {
+  writer.add(trigrams);
+  writer.add(offsets);
+  writer.add(postings);
+}
+
+bool TrigramIndex::load(SnapshotReader &reader) {
+  return reader.read(trigrams) && reader.read(offsets) &&
+         reader.read(postings) && offsets.size() == trigrams.size() + 1 &&
+         offsets[trigrams.size()] == postings.size();
+}
+
+size_t TrigramIndex::memoryUsage() const {
+  return trigrams.memoryUsage() + offsets.memoryUsage() +
+         postings.memoryUsage();
+}
+
+void PrefixIndex::build(const Column &column) {
+  std::vector<uint32_t> ids(column.size());
+  for (uint32_t id = 0; id < column.size(); ++id) {
+    ids[id] = id;
+  }
+
+  std::stable_sort(ids.begin(), ids.end(), [&](uint32_t a, uint32_t b) {
+    return column.get(a) < column.get(b);
+  });
+
+  sorted = Array<uint32_t>(std::move(ids));
+}
+
+PostingList PrefixIndex::find(std::string_view prefix,
+                              const Column &column) const {
+  // First value not below the prefix starts the range
+  auto first = std::lower_bound(
+      sorted.begin(), sorted.end(), prefix,
+      [&](uint32_t id, std::string_view key) { return column.get(id) < key; });
+
+  // Range ends at the first value not starting with the prefix
+  auto last = std::partition_point(first, sorted.end(), [&](uint32_t id) {
+    return column.get(id).substr(0, prefix.size()) == prefix;
+  });
+
+  PostingList result;
+  result.first = sorted.data() + (first - sorted.begin());
+  result.last = sorted.data() + (last - sorted.begin());
+  return result;
+}
+
+void PrefixIndex::split(std::string_view bound, bool inclusive,
+                        const Column &column, PostingList &below,
+                        PostingList &above) const {
+  // Empty values sort first, the values start after them
+  auto first = std::partition_point(sorted.begin(), sorted.end(),
+                                    [&](uint32_t id) {
+                                      return column.get(id).empty();
+                                    });
+
+  auto middle = std::partition_point(first, sorted.end(), [&](uint32_t id) {
+    std::string_view value = column.get(id);
+    return inclusive ? value <= bound : value < bound;
+  });
+
+  below.first = sorted.data() + (first - sorted.begin());
+  below.last = sorted.data() + (middle - sorted.begin());
+  above.first = below.last;
+  above.last = sorted.data() + sorted.size();
+}
+
+void PrefixIndex::save(SnapshotWriter &writer) const { writer.add(sorted); }
+
+bool PrefixIndex::load(SnapshotReader &reader) { return reader.read(sorted); }
+
+size_t PrefixIndex::memoryUsage() const { return sorted.memoryUsage(); }
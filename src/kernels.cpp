@@ -0,0 +1,392 @@
+/**
+ * @file kernels.cpp
+ * @brief This file contains the byte matching and case folding kernels
+ * implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <cstdint>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+#include "../include/kernels.h"
+
+// Memory is protected per page, so reading past a value cannot fault while
+// the read stays in the page holding its last byte
+#define KERNEL_PAGE_SIZE 4096
+
+#define NOT_FOUND std::string_view::npos
+
+// Lead bytes of the two byte UTF-8 sequences of the Latin-1 Supplement and
+// Latin Extended-A letters, the only ones folded besides ASCII
+#define FOLD_LEAD_FIRST 0xC3
+#define FOLD_LEAD_LAST 0xC5
+
+/**
+ * @brief Signature of the kernels, the needle is at least two bytes and not
+ * longer than the haystack
+ */
+using FindKernel = size_t (*)(const char *data, size_t size,
+                              const char *needle, size_t length);
+
+/**
+ * @brief Signature of the case folding kernels
+ */
+using FoldKernel = void (*)(const char *source, char *target, size_t size);
+
+/**
+ * @brief Check whether two bytes lie in the same page
+ */
+static bool samePage(const char *a, const char *b) {
+  return reinterpret_cast<uintptr_t>(a) / KERNEL_PAGE_SIZE ==
+         reinterpret_cast<uintptr_t>(b) / KERNEL_PAGE_SIZE;
+}
+
+/**
+ * @brief Compare the middle of the needle at every candidate position
+ * @param data The haystack
+ * @param position The position of the first bit of the mask
+ * @param mask Candidate positions, their first and last bytes match
+ * @param needle The bytes to look for
+ * @param length The length of the needle
+ * @return The first matching position or NOT_FOUND
+ */
+static size_t checkCandidates(const char *data, size_t position, uint32_t mask,
+                              const char *needle, size_t length) {
+  while (mask) {
+    size_t candidate = position + __builtin_ctz(mask);
+    if (memcmp(data + candidate + 1, needle + 1, length - 2) == 0) {
+      return candidate;
+    }
+    mask &= mask - 1;
+  }
+  return NOT_FOUND;
+}
+
+/**
+ * @brief Find the needle with memchr on its first byte
+ */
+static size_t findScalar(const char *data, size_t size, const char *needle,
+                         size_t length) {
+  const char *end = data + size - length + 1;
+  for (const char *position = data; position < end; ++position) {
+    position = static_cast<const char *>(
+        memchr(position, needle[0], end - position));
+    if (position == nullptr) {
+      break;
+    }
+
+    if (position[length - 1] == needle[length - 1] &&
+        memcmp(position + 1, needle + 1, length - 2) == 0) {
+      return position - data;
+    }
+  }
+  return NOT_FOUND;
+}
+
+/**
+ * @brief Lower case of the letters whose UTF-8 sequence starts with a byte
+ * from FOLD_LEAD_FIRST, indexed by that byte and the low bits of the next
+ */
+struct LatinFoldTable {
+  uint16_t sequences[FOLD_LEAD_LAST - FOLD_LEAD_FIRST + 1][64];
+};
+
+/**
+ * @brief Get the lower case of a Latin-1 Supplement or Latin Extended-A
+ * code point, letters whose lower case takes another number of bytes, such
+ * as U+0130, are kept
+ */
+static uint32_t lowerLatin(uint32_t code) {
+  if (code >= 0xC0 && code <= 0xDE && code != 0xD7) {
+    return code + 0x20;
+  }
+  if (code == 0x178) {
+    return 0xFF;
+  }
+
+  // Upper case letters are followed by their lower case
+  bool evenUpper = (code >= 0x100 && code <= 0x137 && code != 0x130) ||
+                   (code >= 0x14A && code <= 0x177);
+  bool oddUpper = (code >= 0x139 && code <= 0x148) ||
+                  (code >= 0x179 && code <= 0x17E);
+  if ((evenUpper && code % 2 == 0) || (oddUpper && code % 2 == 1)) {
+    return code + 1;
+  }
+  return code;
+}
+
+/**
+ * @brief Encode the lower case of every two byte sequence the table covers
+ */
+static LatinFoldTable buildLatinFoldTable() {
+  LatinFoldTable table;
+  for (uint32_t lead = FOLD_LEAD_FIRST; lead <= FOLD_LEAD_LAST; ++lead) {
+    for (uint32_t low = 0; low < 64; ++low) {
+      uint32_t lower = lowerLatin((lead & 0x1F) << 6 | low);
+      table.sequences[lead - FOLD_LEAD_FIRST][low] =
+          (0xC0 | lower >> 6) << 8 | (0x80 | (lower & 0x3F));
+    }
+  }
+  return table;
+}
+
+static const LatinFoldTable latinFoldTable = buildLatinFoldTable();
+
+/**
+ * @brief Fold the characters starting before the end, the last one may
+ * reach one byte past it
+ * @param source The bytes to fold
+ * @param target Where to write the folded bytes
+ * @param position The first byte to fold
+ * @param end The byte to stop at
+ * @param size The number of bytes
+ * @return The position after the last folded character
+ */
+static size_t foldCharacters(const char *source, char *target,
+                             size_t position, size_t end, size_t size) {
+  while (position < end) {
+    // Two byte sequences keep their length
+    unsigned char byte = source[position];
+    if (byte >= FOLD_LEAD_FIRST && byte <= FOLD_LEAD_LAST &&
+        position + 1 < size &&
+        (static_cast<unsigned char>(source[position + 1]) & 0xC0) == 0x80) {
+      uint16_t lower = latinFoldTable.sequences[byte - FOLD_LEAD_FIRST]
+                                               [source[position + 1] & 0x3F];
+      target[position] = static_cast<char>(lower >> 8);
+      target[position + 1] = static_cast<char>(lower & 0xFF);
+      position += 2;
+      continue;
+    }
+
+    // Upper case ASCII letters get the lower case bit, other bytes are
+    // copied, without a branch as letters of both cases mix
+    bool upper = static_cast<unsigned char>(byte - 'A') < 26;
+    target[position++] = static_cast<char>(byte | upper << 5);
+  }
+  return position;
+}
+
+/**
+ * @brief Fold one character at a time
+ */
+static void foldScalar(const char *source, char *target, size_t size) {
+  foldCharacters(source, target, 0, size, size);
+}
+
+#ifdef KERNELS_X86
+/**
+ * @brief Fold 16 bytes at a time, upper case letters are the bytes above
+ * '@' and below '[', blocks with other than ASCII bytes are left to the
+ * scalar path
+ */
+__attribute__((target("sse4.2"))) static void
+foldSSE42(const char *source, char *target, size_t size) {
+  const __m128i below = _mm_set1_epi8('A' - 1);
+  const __m128i above = _mm_set1_epi8('Z' + 1);
+  const __m128i bit = _mm_set1_epi8(0x20);
+
+  size_t i = 0;
+  while (i + 16 <= size) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+    if (_mm_movemask_epi8(block) != 0) {
+      i = foldCharacters(source, target, i, i + 16, size);
+      continue;
+    }
+
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, below),
+                                  _mm_cmplt_epi8(block, above));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(target + i),
+                     _mm_or_si128(block, _mm_and_si128(upper, bit)));
+    i += 16;
+  }
+  foldCharacters(source, target, i, size, size);
+}
+
+/**
+ * @brief Fold 32 bytes at a time
+ */
+__attribute__((target("avx2"))) static void
+foldAVX2(const char *source, char *target, size_t size) {
+  const __m256i below = _mm256_set1_epi8('A' - 1);
+  const __m256i above = _mm256_set1_epi8('Z' + 1);
+  const __m256i bit = _mm256_set1_epi8(0x20);
+
+  size_t i = 0;
+  while (i + 32 <= size) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i));
+    if (_mm256_movemask_epi8(block) != 0) {
+      i = foldCharacters(source, target, i, i + 32, size);
+      continue;
+    }
+
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(block, below),
+                                     _mm256_cmpgt_epi8(above, block));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(target + i),
+                        _mm256_or_si256(block, _mm256_and_si256(upper, bit)));
+    i += 32;
+  }
+  foldCharacters(source, target, i, size, size);
+}
+
+/**
+ * @brief Find the needle 16 positions at a time, only positions whose first
+ * and last bytes match are compared
+ */
+__attribute__((target("sse4.2"), no_sanitize_address)) static size_t
+findSSE42(const char *data, size_t size, const char *needle, size_t length) {
+  const __m128i first = _mm_set1_epi8(needle[0]);
+  const __m128i last = _mm_set1_epi8(needle[length - 1]);
+  size_t starts = size - length + 1;
+
+  size_t position = 0;
+  for (; position + 16 <= starts; position += 16) {
+    __m128i blockFirst =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + position));
+    __m128i blockLast = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + position + length - 1));
+    uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+
+    size_t found = checkCandidates(data, position, mask, needle, length);
+    if (found != NOT_FOUND) {
+      return found;
+    }
+  }
+
+  if (position == starts) {
+    return NOT_FOUND;
+  }
+
+  // The rest takes one more block when reading past the value is safe
+  if (!samePage(data + size - 1, data + position + length + 14)) {
+    size_t found = findScalar(data + position, size - position, needle, length);
+    return found == NOT_FOUND ? NOT_FOUND : position + found;
+  }
+
+  __m128i blockFirst =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + position));
+  __m128i blockLast = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(data + position + length - 1));
+  uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(first, blockFirst), _mm_cmpeq_epi8(last, blockLast)));
+  mask &= (1u << (starts - position)) - 1;
+  return checkCandidates(data, position, mask, needle, length);
+}
+
+/**
+ * @brief Find the needle 32 positions at a time, only positions whose first
+ * and last bytes match are compared
+ */
+__attribute__((target("avx2"), no_sanitize_address)) static size_t
+findAVX2(const char *data, size_t size, const char *needle, size_t length) {
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[length - 1]);
+  size_t starts = size - length + 1;
+
+  size_t position = 0;
+  for (; position + 32 <= starts; position += 32) {
+    __m256i blockFirst = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + position));
+    __m256i blockLast = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + position + length - 1));
+    uint32_t mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                         _mm256_cmpeq_epi8(last, blockLast)));
+
+    size_t found = checkCandidates(data, position, mask, needle, length);
+    if (found != NOT_FOUND) {
+      return found;
+    }
+  }
+
+  if (position == starts) {
+    return NOT_FOUND;
+  }
+
+  // The rest takes one more block when reading past the value is safe
+  if (!samePage(data + size - 1, data + position + length + 30)) {
+    size_t found = findSSE42(data + position, size - position, needle, length);
+    return found == NOT_FOUND ? NOT_FOUND : position + found;
+  }
+
+  __m256i blockFirst =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + position));
+  __m256i blockLast = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i *>(data + position + length - 1));
+  uint32_t mask = _mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(first, blockFirst),
+                       _mm256_cmpeq_epi8(last, blockLast)));
+  mask &= (1u << (starts - position)) - 1;
+  return checkCandidates(data, position, mask, needle, length);
+}
+#endif
+
+/**
+ * @brief Pick the fastest search kernel the CPU supports
+ */
+static FindKernel selectKernel() {
+#ifdef KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return findAVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return findSSE42;
+  }
+#endif
+  return findScalar;
+}
+
+/**
+ * @brief Pick the fastest case folding kernel the CPU supports
+ */
+static FoldKernel selectFoldKernel() {
+#ifdef KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return foldAVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return foldSSE42;
+  }
+#endif
+  return foldScalar;
+}
+
+static const FindKernel findKernel = selectKernel();
+static const FoldKernel foldKernel = selectFoldKernel();
+
+void foldBytes(const char *source, char *target, size_t size) {
+  foldKernel(source, target, size);
+}
+
+size_t findBytes(std::string_view haystack, std::string_view needle,
+                 size_t start) {
+  if (start > haystack.size() || needle.size() > haystack.size() - start) {
+    return NOT_FOUND;
+  }
+
+  if (needle.empty()) {
+    return start;
+  }
+
+  const char *data = haystack.data() + start;
+  size_t size = haystack.size() - start;
+
+  size_t found;
+  if (needle.size() == 1) {
+    const void *position = memchr(data, needle[0], size);
+    found = position == nullptr ? NOT_FOUND
+                                : static_cast<const char *>(position) - data;
+  } else {
+    found = findKernel(data, size, needle.data(), needle.size());
+  }
+
+  return found == NOT_FOUND ? NOT_FOUND : start + found;
+}
@@ -12,15 +12,22 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 
+#include "../include/directory.h"
+#include "../include/epoll.h"
 #include "../include/message.h"
+#include "../include/output.h"
+#include "../include/planner.h"
+#include "../include/store.h"
 
 #define PORT 389
-#define BUFFER_SIZE 32768 // 32KB
 
 // Gracefully handle SIGINT and SIGTERM
 int sockfd;
@@ -41,71 +48,22 @@ void signalHandler(int signum) {
   exit(signum);
 }
 
-int main(int argc, char *argv[]) {
-  // Set up signal handler
-  signal(SIGINT, signalHandler);
-  signal(SIGTERM, signalHandler);
-
-  std::string inputFile;
-  int port = PORT;
-
-  // Parse args
-  for (int i = 1; i < argc; ++i) {
-    std::string arg = argv[i];
-
-    if (arg == "-p" && i + 1 < argc) {
-      port = std::stoi(argv[i + 1]);
-    } else if (arg == "-f" && i + 1 < argc) {
-      inputFile = argv[i + 1];
-    }
-  }
-
-  // Check if input file is set
-  if (inputFile.empty()) {
-    std::cerr << "Error: Input file not set" << std::endl;
-    exit(EXIT_FAILURE);
-  }
-
-  // Create socket and check for errors
-  sockfd = socket(AF_INET6, SOCK_STREAM, 0);
-  if (sockfd < 0) {
-    std::cerr << "Error: Failed to create socket" << std::endl;
-    exit(EXIT_FAILURE);
-  }
-
-  // Create server address
-  sockaddr_in6 servAddr;
-  servAddr.sin6_family = AF_INET6;
-  servAddr.sin6_port = htons(port);
-  servAddr.sin6_addr = in6addr_any;
-
-  // Bind socket to address
-  if (bind(sockfd, (sockaddr *)&servAddr, sizeof(servAddr)) == -1) {
-    std::cerr << "Error: Failed to bind socket" << std::endl;
-    close(sockfd);
-    exit(EXIT_FAILURE);
-  }
-
-  // Listen for connections
-  if (listen(sockfd, 50) == -1) {
-    std::cerr << "Error: Failed to listen for connections" << std::endl;
-    close(sockfd);
-    exit(EXIT_FAILURE);
-  }
-
-  std::cout << "Listening on port " << port << std::endl;
+// Parallel server, one child process per connection
+void runForkServer(const DirectoryStore &store, size_t watermark) {
+  // Children are never waited for, let the kernel reap them
+  signal(SIGCHLD, SIG_IGN);
 
   // Client address
-  sockaddr_in clientAddr;
-  socklen_t clientAddrLen = sizeof(clientAddr);
+  sockaddr_in6 clientAddr;
+  socklen_t clientAddrLen;
   char host[NI_MAXHOST];
   char service[NI_MAXSERV];
 
   int pid;
 
-  // Parallel server
   while (1) {
     // Accept connection
+    clientAddrLen = sizeof(clientAddr);
     int clientSockfd = accept(sockfd, (sockaddr *)&clientAddr, &clientAddrLen);
     if (clientSockfd == -1) {
       std::cerr << "Error: Failed to accept connection" << std::endl;
@@ -119,8 +77,9 @@ int main(int argc, char *argv[]) {
       close(sockfd);
 
       // Get client info
-      int result = getnameinfo((sockaddr *)&clientAddr, clientAddrLen, host,
-                               NI_MAXHOST, service, NI_MAXSERV, 0);
+      int result =
+          getnameinfo((sockaddr *)&clientAddr, clientAddrLen, host, NI_MAXHOST,
+                      service, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
       if (result) {
         std::cerr << "Error: Failed to get client info" << std::endl;
         close(clientSockfd);
@@ -129,10 +88,15 @@ int main(int argc, char *argv[]) {
 
       std::cout << "Connection from " << host << ":" << service << std::endl;
 
+      // The child owns a copy of the version current at the fork
+      DirectoryReader directory = store.acquire();
+
       // Parse requests
+      MessageFramer framer;
+      OutputBuffer output(clientSockfd, watermark);
+      std::vector<unsigned char> buffer(BUFFER_SIZE);
       while (1) {
         // Read
-        std::vector<unsigned char> buffer(BUFFER_SIZE);
         int bytesReceived = recv(clientSockfd, buffer.data(), BUFFER_SIZE, 0);
 
         // Check for errors
@@ -145,25 +109,9 @@ int main(int argc, char *argv[]) {
           break;
         }
 
-        // Resize buffer to actual size
-        buffer.resize(bytesReceived);
-
-        // Using polymorphism to determine the type of request
-        auto ldapRequest = createLDAPRequest(buffer);
-        ldapRequest->parse();
-        ldapRequest->respond(clientSockfd, inputFile);
-
-        // If ldaprequest is nullptr, it is not supported, close connection
-        if (ldapRequest == nullptr) {
-          std::cout << "Unsupported request received" << std::endl;
-          close(clientSockfd);
-          break;
-        }
-
-        // Check if request is instance of Unbind
-        if (dynamic_cast<Unbind *>(ldapRequest.get())) {
-          std::cout << "Unbind request received" << std::endl;
-          close(clientSockfd);
+        // A read may hold a part of a request or several requests
+        framer.append(buffer.data(), bytesReceived);
+        if (!handleReceivedData(framer, output, *directory)) {
           break;
         }
       }
@@ -177,3 +125,146 @@ int main(int argc, char *argv[]) {
     }
   }
 }
+
+int main(int argc, char *argv[]) {
+  // Set up signal handler
+  signal(SIGINT, signalHandler);
+  signal(SIGTERM, signalHandler);
+
+  std::string inputFile;
+  std::string compileFile;
+  std::string outputFile;
+  std::string mode = "fork";
+  int port = PORT;
+  size_t loadThreads = std::thread::hardware_concurrency();
+  size_t watermark = OUTPUT_WATERMARK;
+  size_t scanThreads = std::thread::hardware_concurrency();
+  size_t cacheSize = RESULT_CACHE_SIZE;
+
+  // Parse args
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+
+    if (arg == "-p" && i + 1 < argc) {
+      port = std::stoi(argv[i + 1]);
+    } else if (arg == "-f" && i + 1 < argc) {
+      inputFile = argv[i + 1];
+    } else if (arg == "-m" && i + 1 < argc) {
+      mode = argv[i + 1];
+    } else if (arg == "--compile" && i + 1 < argc) {
+      compileFile = argv[i + 1];
+    } else if (arg == "-o" && i + 1 < argc) {
+      outputFile = argv[i + 1];
+    } else if (arg == "--load-threads" && i + 1 < argc) {
+      loadThreads = std::stoul(argv[i + 1]);
+    } else if (arg == "--output-watermark" && i + 1 < argc) {
+      watermark = std::stoul(argv[i + 1]);
+    } else if (arg == "--scan-threads" && i + 1 < argc) {
+      scanThreads = std::stoul(argv[i + 1]);
+    } else if (arg == "--cache-size" && i + 1 < argc) {
+      cacheSize = std::stoul(argv[i + 1]);
+    }
+  }
+
+  if (mode != "fork" && mode != "epoll") {
+    std::cerr << "Error: Unknown server mode " << mode << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Compile the CSV file into a snapshot instead of serving it
+  if (!compileFile.empty()) {
+    if (outputFile.empty()) {
+      std::cerr << "Error: Snapshot file not set" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    Directory directory;
+    if (!directory.load(compileFile, loadThreads)) {
+      std::cerr << "Error: Failed to open input file " << compileFile
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    if (!directory.save(outputFile)) {
+      exit(EXIT_FAILURE);
+    }
+
+    std::cout << "Compiled " << directory.size() << " entries from "
+              << compileFile << " into " << outputFile << std::endl;
+    exit(0);
+  }
+
+  // Check if input file is set
+  if (inputFile.empty()) {
+    std::cerr << "Error: Input file not set" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Load the directory once, every connection shares it
+  auto directory = std::make_unique<Directory>();
+  auto loadStart = std::chrono::steady_clock::now();
+  if (!directory->load(inputFile, loadThreads)) {
+    std::cerr << "Error: Failed to open input file " << inputFile << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - loadStart);
+
+  std::cout << "Loaded " << directory->size() << " entries from " << inputFile
+            << " in " << loadTime.count() << " ms ("
+            << directory->memoryUsage() / 1024 << " KiB)" << std::endl;
+
+  FilterPlanner::setScanThreads(scanThreads);
+
+  // Results are cached per process, forked children start with it empty
+  ResultCache cache(cacheSize);
+  Search::setResultCache(&cache);
+
+  // Reload the directory whenever the file changes
+  DirectoryStore store(std::move(directory));
+  DirectoryWatcher watcher(store, inputFile, loadThreads);
+  if (!watcher.start()) {
+    std::cerr << "Error: Changes of " << inputFile << " will not be reloaded"
+              << std::endl;
+  }
+
+  // Create socket and check for errors
+  sockfd = socket(AF_INET6, SOCK_STREAM, 0);
+  if (sockfd < 0) {
+    std::cerr << "Error: Failed to create socket" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Create server address
+  sockaddr_in6 servAddr;
+  servAddr.sin6_family = AF_INET6;
+  servAddr.sin6_port = htons(port);
+  servAddr.sin6_addr = in6addr_any;
+
+  // Bind socket to address
+  if (bind(sockfd, (sockaddr *)&servAddr, sizeof(servAddr)) == -1) {
+    std::cerr << "Error: Failed to bind socket" << std::endl;
+    close(sockfd);
+    exit(EXIT_FAILURE);
+  }
+
+  // Listen for connections
+  if (listen(sockfd, 50) == -1) {
+    std::cerr << "Error: Failed to listen for connections" << std::endl;
+    close(sockfd);
+    exit(EXIT_FAILURE);
+  }
+
+  std::cout << "Listening on port " << port << std::endl;
+
+  if (mode == "epoll") {
+    EpollServer server(sockfd, store, std::thread::hardware_concurrency(),
+                       std::thread::hardware_concurrency(), watermark);
+    server.run();
+  } else {
+    runForkServer(store, watermark);
+  }
+
+  close(sockfd);
+  exit(EXIT_FAILURE);
+}
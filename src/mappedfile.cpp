@@ -0,0 +1,52 @@
+/**
+ * @file mappedfile.cpp
+ * @brief This file contains the MappedFile class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/mappedfile.h"
+
+MappedFile::~MappedFile() { close(); }
+
+void MappedFile::close() {
+  if (address != nullptr) {
+    munmap(address, length);
+    address = nullptr;
+  }
+  length = 0;
+}
+
+bool MappedFile::open(const std::string &filename) {
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    ::close(fd);
+    return false;
+  }
+
+  // Empty files can not be mapped, there is just nothing to read
+  length = info.st_size;
+  if (length > 0) {
+    address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      address = nullptr;
+      length = 0;
+      ::close(fd);
+      return false;
+    }
+
+    // Loading reads the whole file, start reading ahead right away
+    madvise(address, length, MADV_WILLNEED);
+  }
+
+  ::close(fd);
+  return true;
+}
@@ -4,71 +4,79 @@
  * subclasses
  * @author Simon Bencik <xbenci01>
  */
-#include <sys/socket.h>
-
 #include "../include/message.h"
+#include "../include/planner.h"
 #include "../include/search.h"
 
+// Number of cache lookups between two reports of the hit and miss counts
+#define RESULT_CACHE_REPORT 1000
+
+// Number of matches a search publishes at once to the identical searches
+#define RESULT_FLIGHT_CHUNK 1024
+
+// Cache shared by all searches, set before the first search
+static ResultCache *resultCache = nullptr;
+
+// Number of cache lookups so far, each one takes its own count
+static std::atomic<uint64_t> resultCacheLookups{0};
+
 // For each message, we need to parse the message ID and the protocol op
 void LDAPMessage::init() {
-  std::vector<unsigned char> tmpSeq;
+  std::string_view tmpSeq;
   parser.getSequence(tmpSeq);
 
   parser.getInteger(messageID);
 
-  unsigned char length;
+  size_t length;
   parser.getTag(protocolOp);
   parser.getLength(length);
 }
 
-void Bind::parse() {
+bool Bind::parse() {
   std::cout << "Bind request <-" << std::endl;
-  unsigned char version;
+  int32_t version;
   parser.getInteger(version);
 
-  std::vector<unsigned char> name;
+  std::string_view name;
   parser.getOctetString(name);
+  return true;
 }
 
-void Bind::respond(int fd, std::string inputFile) {
-  std::cout << "Bind response ->" << std::endl;
-  std::vector<unsigned char> response;
-
-  // Add the sequence
-  response.push_back(0x30);
+void LDAPMessage::sendResult(OutputBuffer &output, int32_t messageID,
+                             unsigned char protocolOp,
+                             unsigned char resultCode) {
+  // Sizes first, the message is then written straight into the output
+  size_t resultSize = BEREncoder::tlvSize(BEREncoder::integerSize(resultCode)) +
+                      2 * BEREncoder::tlvSize(0);
+  size_t messageSize = BEREncoder::tlvSize(BEREncoder::integerSize(messageID)) +
+                       BEREncoder::tlvSize(resultSize);
+  BEREncoder encoder(output.reserve(BEREncoder::tlvSize(messageSize)));
 
-  // Add the length
-  response.push_back(0x0C);
-
-  // Add the message ID
-  response.push_back(0x02);
-  response.push_back(0x01);
-  response.push_back(messageID);
+  // LDAPMessage sequence
+  encoder.putHeader(0x30, messageSize);
 
-  // Add the protocol op
-  response.push_back(0x61);
+  // Message ID
+  encoder.putInteger(messageID);
 
-  // Add the length
-  response.push_back(0x07);
+  // ProtocolOp
+  encoder.putHeader(protocolOp, resultSize);
 
-  // Add the bind response
-  response.push_back(0x0A);
-  response.push_back(0x01);
-  response.push_back(0x00);
+  // Result code
+  encoder.putInteger(resultCode, 0x0A);
 
-  // Add the matched DN
-  response.push_back(0x04);
-  response.push_back(0x00);
+  // Matched DN and diagnostic message
+  encoder.putOctetString("");
+  encoder.putOctetString("");
+}
 
-  // Add the diagnostic message
-  response.push_back(0x04);
-  response.push_back(0x00);
+void Bind::respond(OutputBuffer &output, const Directory &directory) {
+  std::cout << "Bind response ->" << std::endl;
 
-  // Send the response
-  send(fd, response.data(), response.size(), 0);
+  // Bind always succeeds
+  sendResult(output, messageID, 0x61, 0x00);
 }
 
-void Search::parse() {
+bool Search::parse() {
   std::cout << "Search request <-" << std::endl;
   parser.getOctetString(baseObject);
   parser.getEnum(scope);
@@ -76,167 +84,240 @@ void Search::parse() {
   parser.getInteger(sizeLimit);
   parser.getInteger(timeLimit);
   parser.getBool(typesOnly);
-  parser.getFilter(filter);
-}
-
-void Search::addAttribute(std::vector<unsigned char> &message,
-                          const std::string &type, const std::string &value) {
-  // Start the attribute SEQUENCE
-  message.push_back(0x30);
-  int attributeStartPos = message.size();
-  message.push_back(0x00); // Placeholder for length
 
-  // Attribute type
-  message.push_back(0x04);
-  message.push_back(static_cast<unsigned char>(type.size())); // length
-  for (unsigned char c : type) {
-    message.push_back(c);
+  // A malformed filter or one nested too deep is rejected before it is
+  // searched recursively
+  if (!parser.getFilter(filter, arena)) {
+    std::cout << "Invalid filter received" << std::endl;
+    return false;
   }
+  foldFilter(filter, arena);
+  return true;
+}
 
-  // Attribute value set
-  message.push_back(0x31);
-  int setValueStartPos = message.size();
-  message.push_back(0x00); // Placeholder for length
+void Search::sendSearchResEntry(int32_t messageID, std::string_view body,
+                                OutputBuffer &output) {
+  // Only the envelope is encoded here, the body was encoded at load time
+  size_t messageSize = BEREncoder::tlvSize(BEREncoder::integerSize(messageID)) +
+                       BEREncoder::tlvSize(body.size());
+  BEREncoder encoder(
+      output.reserve(BEREncoder::tlvSize(messageSize) - body.size()));
 
-  // Attribute value
-  message.push_back(0x04);
+  // LDAPMessage sequence
+  encoder.putHeader(0x30, messageSize);
 
-  // print the value size
-  message.push_back(static_cast<unsigned char>(value.size())); // length
-  for (unsigned char c : value) {
-    message.push_back(c);
-  }
+  // Message ID
+  encoder.putInteger(messageID);
 
-  // update set len
-  message[setValueStartPos] =
-      static_cast<unsigned char>(message.size() - setValueStartPos - 1);
+  // ProtocolOp
+  encoder.putHeader(0x64, body.size());
 
-  // update attr len
-  message[attributeStartPos] =
-      static_cast<unsigned char>(message.size() - attributeStartPos - 1);
+  // Send the message
+  output.appendView(body.data(), body.size());
 }
 
-void Search::sendSearchResEntry(const FileEntry &entry, int fd) {
-  std::vector<unsigned char> message;
+void Search::sendEntry(uint32_t id, const EntryEncodings &encodings,
+                       OutputBuffer &output) {
+  // Once the socket does not take the responses, the rest of the search
+  // waits as ids instead of encoded entries and the queue stops growing
+  if (tail.ids.empty()) {
+    if (!output.full() || (output.flush(true) && !output.full())) {
+      sendSearchResEntry(messageID, encodings.get(id), output);
+      return;
+    }
+    tail.messageID = messageID;
+    tail.encodings = &encodings;
+  }
+  tail.ids.append(id);
+}
 
-  // LDAPMessage sequence
-  message.push_back(0x30);
-  message.push_back(0x00); // Placeholder for length
+void Search::sendSearchResDone(OutputBuffer &output, bool sizeLimitReached) {
+  // Result code is sizeLimitExceeded or success
+  unsigned char resultCode = sizeLimitReached ? 0x04 : 0x00;
+  if (tail.ids.empty()) {
+    sendResult(output, messageID, 0x65, resultCode);
+    return;
+  }
 
-  // Message ID
-  message.push_back(0x02);
-  message.push_back(0x01);
-  message.push_back(messageID);
+  // The tail sends it after the last entry
+  tail.resultCode = resultCode;
+  output.defer(std::move(tail));
+  tail = Tail();
+}
 
-  // ProtocolOp
-  message.push_back(0x64);
-  int searchResEntryStartPos = message.size();
-  message.push_back(0x00); // Placeholder for length
-
-  // ObjectName (DN)
-  std::string uidString(entry.uid.begin(), entry.uid.end());
-  std::string dn = "uid=" + uidString;
-
-  // Append the DN
-  message.push_back(0x04);
-  message.push_back(static_cast<unsigned char>(dn.size()));
-  for (char c : dn) {
-    message.push_back(c);
+bool Search::Tail::operator()(OutputBuffer &output) {
+  // Resumes after the entries queued by the previous call
+  bool sent = ids.forEachFrom(next, [&](uint32_t id) {
+    if (output.full() || output.failed()) {
+      next = id;
+      return false;
+    }
+    sendSearchResEntry(messageID, encodings->get(id), output);
+    return true;
+  });
+  if (!sent) {
+    return true;
   }
 
-  // Attributes SEQUENCE
-  message.push_back(0x30);
-  int attributesSeqStartPos = message.size();
-  message.push_back(0x00);
+  sendResult(output, messageID, 0x65, resultCode);
+  return false;
+}
 
-  // Add the attributes
-  addAttribute(message, "cn", entry.cn);
-  addAttribute(message, "mail", entry.mail);
+void Search::setResultCache(ResultCache *cache) { resultCache = cache; }
 
-  // update sequence len
-  message[attributesSeqStartPos] =
-      static_cast<unsigned char>(message.size() - attributesSeqStartPos - 1);
+bool Search::sendMatches(OutputBuffer &output, const Directory &directory,
+                         size_t skip,
+                         const std::function<void(uint32_t)> &found) {
+  const auto &encodings = directory.getEncodings();
+  bool sizeLimitReached = false;
+  size_t count = 0;
 
-  // update protocol op len
-  message[searchResEntryStartPos] =
-      static_cast<unsigned char>(message.size() - searchResEntryStartPos - 1);
+  // Send the matches as they are found, ids come out in file order, one
+  // match past the size limit is enough to report it
+  program.compile(filter);
+  FilterPlanner planner(directory);
+  size_t limit = sizeLimit > 0 ? static_cast<size_t>(sizeLimit) + 1 : 0;
+  planner.match(filter, program, limit, [&](uint32_t id) {
+    if (sizeLimit > 0 && count == static_cast<size_t>(sizeLimit)) {
+      sizeLimitReached = true;
+      return false;
+    }
 
-  // update message len
-  message[1] = static_cast<unsigned char>(message.size() - 2);
+    if (count >= skip) {
+      sendEntry(id, encodings, output);
+      if (found) {
+        found(id);
+      }
+    }
+    count++;
+    return true;
+  });
 
-  // Send the message
-  send(fd, message.data(), message.size(), 0);
+  return sizeLimitReached;
 }
 
-void Search::sendSearchResDone(int fd, bool sizeLimitReached) {
-  // Add the search result done message
-  std::vector<unsigned char> done;
+void Search::leadSearch(OutputBuffer &output, const Directory &directory,
+                        const std::string &key,
+                        std::shared_ptr<SearchFlight> flight) {
+  std::vector<uint32_t> chunk;
+  bool sizeLimitReached = false;
 
-  // Sequence
-  done.push_back(0x30);
-  done.push_back(0x0c);
+  // The matches are published in chunks as they are sent, the readers never
+  // wait for the whole result or for this connection
+  try {
+    sizeLimitReached = sendMatches(output, directory, 0, [&](uint32_t id) {
+      if (flight == nullptr) {
+        return;
+      }
+
+      chunk.push_back(id);
+      if (chunk.size() < RESULT_FLIGHT_CHUNK) {
+        return;
+      }
+      flight->publish(chunk);
+      chunk.clear();
+
+      // Nobody would use a result too big to be cached
+      if (!resultCache->fits(flight->size()) &&
+          resultCache->release(key, flight)) {
+        flight = nullptr;
+      }
+    });
+
+    if (flight != nullptr) {
+      flight->publish(chunk);
+      resultCache->complete(key, flight, sizeLimitReached);
+    }
+  } catch (...) {
+    // The readers would wait forever for a search which failed
+    if (flight != nullptr) {
+      resultCache->abandon(key, flight);
+    }
+    throw;
+  }
 
-  // messageID
-  done.push_back(0x02);
-  done.push_back(0x01);
-  done.push_back(messageID);
+  sendSearchResDone(output, sizeLimitReached);
+}
 
-  // protocolOp
-  done.push_back(0x65);
-  done.push_back(0x07);
+void Search::followSearch(OutputBuffer &output, const Directory &directory,
+                          const std::shared_ptr<SearchFlight> &flight) {
+  const auto &encodings = directory.getEncodings();
+  std::vector<uint32_t> chunk;
+  size_t sent = 0;
+  bool sizeLimitReached = false;
 
-  // resultCode
-  done.push_back(0x0a);
-  done.push_back(0x01);
-  sizeLimitReached ? done.push_back(0x04) : done.push_back(0x00);
+  // Every search encodes the entries with its own message ID
+  SearchFlight::State state;
+  do {
+    state = flight->read(sent, chunk, sizeLimitReached);
+    for (uint32_t id : chunk) {
+      sendEntry(id, encodings, output);
+    }
+    sent += chunk.size();
+  } while (state == SearchFlight::State::Running);
 
-  // matchedDN
-  done.push_back(0x04);
-  done.push_back(0x00);
+  // The leading search failed, the matches after the sent ones are found here
+  if (state == SearchFlight::State::Abandoned) {
+    sizeLimitReached = sendMatches(output, directory, sent, nullptr);
+  }
 
-  // errorMessage
-  done.push_back(0x04);
-  done.push_back(0x00);
-  send(fd, done.data(), done.size(), 0);
+  sendSearchResDone(output, sizeLimitReached);
 }
 
-void Search::respond(int fd, std::string inputFile) {
+void Search::respond(OutputBuffer &output, const Directory &directory) {
   std::cout << "Search response ->" << std::endl;
 
-  auto entries = readCSV(inputFile);
-  bool sizeLimitReached = false;
-  size_t count = 0;
-
-  std::vector<FileEntry> filteredEntries;
-  // Apply filter to each entry
-  for (const auto &entry : entries) {
-    if (filterEntry(filter, entry)) {
-      filteredEntries.push_back(entry);
-      count++;
-    }
+  // Without a cache nothing is collected, the matches are only sent
+  if (resultCache == nullptr || !resultCache->enabled()) {
+    sendSearchResDone(output, sendMatches(output, directory, 0, nullptr));
+    return;
   }
 
-  // Check for size constraint and truncate if necessary
-  if (sizeLimit != 0 && count > sizeLimit) {
-    sizeLimitReached = true;
-    filteredEntries.resize(sizeLimit);
-  }
+  std::string key;
+  ResultCache::makeKey(filter, sizeLimit, key);
+  CacheLookup found = resultCache->find(key, directory.getVersion());
 
-  for (const auto &entry : filteredEntries) {
-    sendSearchResEntry(entry, fd);
+  // Exactly one search reports every RESULT_CACHE_REPORT lookups
+  if ((resultCacheLookups.fetch_add(1) + 1) % RESULT_CACHE_REPORT == 0) {
+    std::cout << "Result cache: " << resultCache->hits() << " hits, "
+              << resultCache->misses() << " misses, "
+              << resultCache->shared() << " shared" << std::endl;
   }
 
-  sendSearchResDone(fd, sizeLimitReached);
+  if (found.result != nullptr) {
+    // The same search on the same directory sends the same entries
+    const auto &encodings = directory.getEncodings();
+    for (uint32_t id : found.result->ids) {
+      sendEntry(id, encodings, output);
+    }
+    sendSearchResDone(output, found.result->sizeLimitReached);
+  } else if (found.flight == nullptr) {
+    sendSearchResDone(output, sendMatches(output, directory, 0, nullptr));
+  } else if (found.leading) {
+    leadSearch(output, directory, key, std::move(found.flight));
+  } else {
+    followSearch(output, directory, found.flight);
+  }
 }
 
-void Unbind::parse() { std::cout << "Unbind request <-" << std::endl; }
+bool Unbind::parse() {
+  std::cout << "Unbind request <-" << std::endl;
+  return true;
+}
 
-void Unbind::respond(int fd, std::string inputFile){};
+void Unbind::respond(OutputBuffer &output, const Directory &directory){};
 
 // Determine the type of request and create the appropriate object
-std::unique_ptr<LDAPMessage>
-createLDAPRequest(std::vector<unsigned char> &buffer) {
-  unsigned char protocolOp = buffer[5];
+std::unique_ptr<LDAPMessage> createLDAPRequest(std::string_view buffer) {
+  // Skip the message envelope and the message ID to get the protocol op
+  BERParser parser(buffer);
+  unsigned char tag, protocolOp;
+  size_t length;
+  int32_t messageID;
+  if (!parser.getTag(tag) || !parser.getLength(length) ||
+      !parser.getInteger(messageID) || !parser.getTag(protocolOp)) {
+    return nullptr;
+  }
 
   switch (protocolOp) {
   case 0x60:
@@ -251,3 +332,59 @@ createLDAPRequest(std::vector<unsigned char> &buffer) {
     return nullptr;
   }
 }
+
+bool handleLDAPRequest(std::string_view buffer, OutputBuffer &output,
+                       const Directory &directory) {
+  // Using polymorphism to determine the type of request
+  auto ldapRequest = createLDAPRequest(buffer);
+
+  // If ldaprequest is nullptr, it is not supported, close connection
+  if (ldapRequest == nullptr) {
+    std::cout << "Unsupported request received" << std::endl;
+    return false;
+  }
+
+  // An invalid request is not answered, the connection is closed
+  if (!ldapRequest->parse()) {
+    return false;
+  }
+  ldapRequest->respond(output, directory);
+
+  // Check if request is instance of Unbind
+  if (dynamic_cast<Unbind *>(ldapRequest.get())) {
+    std::cout << "Unbind request received" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool handleReceivedData(MessageFramer &framer, OutputBuffer &output,
+                        const Directory &directory) {
+  std::string_view pdu;
+
+  // Respond to pipelined requests in the order they were received, the
+  // responses are sent together
+  while (true) {
+    switch (framer.next(pdu)) {
+    case FrameStatus::Complete:
+      if (!handleLDAPRequest(pdu, output, directory) || output.failed()) {
+        output.flush();
+        return false;
+      }
+
+      // The client does not take the responses, the remaining requests stay
+      // in the framer until the output drains
+      if (output.full() && output.flush() && output.full()) {
+        return true;
+      }
+      break;
+    case FrameStatus::Incomplete:
+      return output.flush();
+    case FrameStatus::Invalid:
+      std::cout << "Invalid message received" << std::endl;
+      output.flush();
+      return false;
+    }
+  }
+}
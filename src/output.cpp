@@ -0,0 +1,167 @@
+/**
+ * @file output.cpp
+ * @brief This file contains the OutputBuffer class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "../include/output.h"
+
+unsigned char *OutputBuffer::reserve(size_t size) {
+  // Send what is pending first, the reserved bytes are not written yet
+  if (full() && !blocked) {
+    flush(true);
+  }
+
+  // Grow the last segment when it ends the owned bytes
+  size_t offset = owned.size();
+  if (!segments.empty() && segments.back().data == nullptr &&
+      segments.back().offset + segments.back().size == offset) {
+    segments.back().size += size;
+  } else if (size > 0) {
+    segments.push_back({nullptr, offset, size});
+  }
+
+  owned.resize(offset + size);
+  pending += size;
+  return owned.data() + offset;
+}
+
+void OutputBuffer::append(const void *data, size_t size) {
+  if (size > 0) {
+    memcpy(reserve(size), data, size);
+  }
+}
+
+void OutputBuffer::appendView(const void *data, size_t size) {
+  if (size < OUTPUT_VIEW_MIN_SIZE) {
+    append(data, size);
+    return;
+  }
+
+  if (full() && !blocked) {
+    flush(true);
+  }
+
+  segments.push_back({data, 0, size});
+  pending += size;
+}
+
+void OutputBuffer::defer(std::function<bool(OutputBuffer &)> source) {
+  if (!error) {
+    this->source = std::move(source);
+  }
+}
+
+void OutputBuffer::hold(std::shared_ptr<const void> owner) {
+  if (owners.empty() || owners.back() != owner) {
+    owners.push_back(std::move(owner));
+  }
+}
+
+bool OutputBuffer::flush(bool more) {
+  blocked = false;
+
+  while (true) {
+    sendQueued(more);
+
+    // The source queues more once the socket took everything queued
+    if (error || blocked || source == nullptr) {
+      break;
+    }
+
+    // It sees only the queued bytes, the sends while it queues neither call
+    // it again nor release the owners it reads from
+    auto next = std::move(source);
+    source = nullptr;
+    refilling = true;
+    bool left = next(*this);
+    refilling = false;
+    if (left && !error) {
+      source = std::move(next);
+    }
+  }
+
+  // Nothing more will be sent
+  if (error) {
+    source = nullptr;
+  }
+  if (!refilling && source == nullptr && (error || pending == 0)) {
+    owners.clear();
+  }
+  return !error;
+}
+
+void OutputBuffer::sendQueued(bool more) {
+  std::vector<iovec> vectors;
+  while (!error && first < segments.size()) {
+    size_t count = std::min<size_t>(segments.size() - first, IOV_MAX);
+    vectors.clear();
+    for (size_t i = first; i < first + count; ++i) {
+      const Segment &segment = segments[i];
+      const void *data = segment.data == nullptr
+                             ? owned.data() + segment.offset
+                             : segment.data;
+      vectors.push_back({const_cast<void *>(data), segment.size});
+    }
+
+    msghdr message = {};
+    message.msg_iov = vectors.data();
+    message.msg_iovlen = count;
+
+    // Only the last send of the last batch pushes out a partial segment
+    int flags = MSG_NOSIGNAL;
+    if (more || source != nullptr || first + count < segments.size()) {
+      flags |= MSG_MORE;
+    }
+
+    ssize_t result = sendmsg(fd, &message, flags);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      // The send buffer is full, the rest waits until the socket is writable
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        blocked = true;
+        break;
+      }
+
+      std::cerr << "Error: Failed to send response" << std::endl;
+      error = true;
+      break;
+    }
+
+    // Skip the segments sent whole, trim the one sent in part
+    size_t sent = result;
+    pending -= sent;
+    while (first < segments.size() && sent >= segments[first].size) {
+      sent -= segments[first].size;
+      first++;
+    }
+    if (sent > 0) {
+      Segment &segment = segments[first];
+      if (segment.data == nullptr) {
+        segment.offset += sent;
+      } else {
+        segment.data = static_cast<const char *>(segment.data) + sent;
+      }
+      segment.size -= sent;
+    }
+  }
+
+  // Everything sent, or nothing more will be
+  if (error || first == segments.size()) {
+    owned.clear();
+    segments.clear();
+    first = 0;
+    pending = 0;
+  }
+}
@@ -0,0 +1,360 @@
+/**
+ * @file planner.cpp
+ * @brief This file contains the FilterPlanner class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "../include/planner.h"
+#include "../include/threadpool.h"
+
+// Fewest undecided entries worth spreading over the scan pool
+#define PARALLEL_SCAN_MIN 65536
+
+// Threads checking the entries of one search, set before the first search
+static size_t scanThreads = 1;
+
+/**
+ * @brief Get the pool shared by all searches, created on first use so a
+ * forked child starts its own threads
+ */
+static ThreadPool &getScanPool() {
+  static ThreadPool pool(scanThreads - 1);
+  return pool;
+}
+
+/**
+ * @struct ParallelScan
+ * @brief State shared by the threads checking one search, a range is one
+ * container of the candidates
+ */
+struct ParallelScan {
+  const Bitmap *sure;
+  const Bitmap *candidates;
+  const FilterProgram *program;
+  const EntryTable *entries;
+  size_t limit;
+
+  /**
+   * @brief Matches found so far in all ranges
+   */
+  std::atomic<size_t> matched{0};
+
+  /**
+   * @brief Guards the fields below
+   */
+  std::mutex mutex;
+  /**
+   * @brief Signals that a range is done
+   */
+  std::condition_variable changed;
+  /**
+   * @brief Matches of every range
+   */
+  std::vector<std::vector<uint32_t>> matches;
+  /**
+   * @brief Whether the range is done
+   */
+  std::vector<bool> done;
+  /**
+   * @brief The first range not taken yet, ranges are taken in order
+   */
+  size_t next = 0;
+  /**
+   * @brief Number of ranges done
+   */
+  size_t completed = 0;
+  /**
+   * @brief Set once no more ranges should be taken
+   */
+  bool stopped = false;
+};
+
+/**
+ * @brief Take the next range and check it
+ * @param scan The scan to work on
+ * @return Whether a range was checked
+ */
+static bool scanNextRange(ParallelScan &scan) {
+  size_t range;
+  {
+    std::lock_guard<std::mutex> lock(scan.mutex);
+    if (scan.stopped || scan.next == scan.matches.size()) {
+      return false;
+    }
+    range = scan.next++;
+  }
+
+  std::vector<uint32_t> found;
+  scan.candidates->forEachInContainer(range, [&](uint32_t id) {
+    if (scan.sure->contains(id) || scan.program->matches(*scan.entries, id)) {
+      found.push_back(id);
+    }
+    return true;
+  });
+
+  // Ranges are taken in order, so once the taken ones hold enough matches
+  // the rest are not needed
+  size_t matched = scan.matched.fetch_add(found.size()) + found.size();
+  {
+    std::lock_guard<std::mutex> lock(scan.mutex);
+    scan.matches[range] = std::move(found);
+    scan.done[range] = true;
+    scan.completed++;
+    if (scan.limit != 0 && matched >= scan.limit) {
+      scan.stopped = true;
+    }
+  }
+  scan.changed.notify_all();
+  return true;
+}
+
+/**
+ * @brief Make a bitmap of ids which are in value order, as looked up in a
+ * prefix index
+ * @param list The ids
+ */
+static Bitmap fromValueOrder(const PostingList &list) {
+  std::vector<uint32_t> ids(list.begin(), list.end());
+  std::sort(ids.begin(), ids.end());
+  return Bitmap::fromSorted(ids.data(), ids.data() + ids.size());
+}
+
+FilterPlanner::FilterPlanner(const Directory &directory)
+    : directory(directory), universe(directory.getAllIds()) {}
+
+void FilterPlanner::setScanThreads(size_t threads) {
+  scanThreads = threads == 0 ? 1 : threads;
+}
+
+void FilterPlanner::match(const Filter &filter, const FilterProgram &program,
+                          size_t limit,
+                          const std::function<bool(uint32_t)> &visit) const {
+  FilterPlan result = plan(filter);
+  if (result.maybe.empty()) {
+    result.sure.forEach(visit);
+    return;
+  }
+
+  Bitmap candidates = result.sure | result.maybe;
+  if (scanThreads > 1 && candidates.containerCount() > 1 &&
+      result.maybe.cardinality() >= PARALLEL_SCAN_MIN) {
+    matchParallel(result, candidates, program, limit, visit);
+    return;
+  }
+
+  // Unindexable parts are checked only on the surviving candidates, and only
+  // as far as the caller keeps reading
+  const auto &entries = directory.getEntries();
+  candidates.forEach([&](uint32_t id) {
+    if (!result.sure.contains(id) && !program.matches(entries, id)) {
+      return true;
+    }
+    return visit(id);
+  });
+}
+
+void FilterPlanner::matchParallel(
+    const FilterPlan &plan, const Bitmap &candidates,
+    const FilterProgram &program, size_t limit,
+    const std::function<bool(uint32_t)> &visit) const {
+  // Queued tasks may start after the search is over, they only keep the
+  // state alive and find no range left
+  auto scan = std::make_shared<ParallelScan>();
+  scan->sure = &plan.sure;
+  scan->candidates = &candidates;
+  scan->program = &program;
+  scan->entries = &directory.getEntries();
+  scan->limit = limit;
+  scan->matches.resize(candidates.containerCount());
+  scan->done.resize(candidates.containerCount(), false);
+
+  ThreadPool &pool = getScanPool();
+  size_t helpers = std::min(pool.size(), candidates.containerCount() - 1);
+  for (size_t i = 0; i < helpers; ++i) {
+    pool.submit([scan] {
+      while (scanNextRange(*scan)) {
+      }
+    });
+  }
+
+  // Visit the ranges in order, checking ranges here as well while waiting,
+  // the pool may be busy with other searches
+  bool visiting = true;
+  for (size_t range = 0; visiting && range < scan->matches.size(); ++range) {
+    // Done, or never taken since the limit was reached before it
+    auto ready = [&] {
+      return scan->done[range] || (scan->stopped && range >= scan->next);
+    };
+
+    std::unique_lock<std::mutex> lock(scan->mutex);
+    while (!ready()) {
+      lock.unlock();
+      bool scanned = scanNextRange(*scan);
+      lock.lock();
+      if (!scanned) {
+        scan->changed.wait(lock, ready);
+      }
+    }
+    if (!scan->done[range]) {
+      break;
+    }
+    lock.unlock();
+
+    for (uint32_t id : scan->matches[range]) {
+      if (!visit(id)) {
+        visiting = false;
+        break;
+      }
+    }
+    std::vector<uint32_t>().swap(scan->matches[range]);
+  }
+
+  // The ranges already taken use the plan and the program, wait for them
+  std::unique_lock<std::mutex> lock(scan->mutex);
+  scan->stopped = true;
+  scan->changed.wait(lock, [&] { return scan->completed == scan->next; });
+}
+
+FilterPlan FilterPlanner::plan(const Filter &filter) const {
+  switch (filter.type) {
+  case FilterType::AND:
+    return planAND(filter.filters);
+  case FilterType::OR:
+    return planOR(filter.filters);
+  case FilterType::NOT:
+    if (filter.filters.size() != 1) {
+      return {};
+    }
+    return planNOT(filter.filters[0]);
+  default:
+    return planLeaf(filter);
+  }
+}
+
+FilterPlan FilterPlanner::planLeaf(const Filter &filter) const {
+  FilterPlan result;
+  PostingList list;
+
+  switch (filter.type) {
+  case FilterType::Present: {
+    // Entries with an empty value do not have the attribute
+    EqType missing = {filter.present, std::string_view()};
+    if (isObjectClass(filter.present)) {
+      result.sure = universe;
+    } else if (directory.findEqual(missing, list)) {
+      result.sure = universe - Bitmap::fromSorted(list.begin(), list.end());
+    }
+    break;
+  }
+  case FilterType::EqualityMatch:
+  case FilterType::ApproxMatch:
+    // Unknown attributes never match, the attributes define no approximate
+    // rule so approxMatch is an equality match
+    if (directory.findEqual(filter.equalityMatch, list)) {
+      result.sure = Bitmap::fromSorted(list.begin(), list.end());
+    }
+    break;
+  case FilterType::GreaterOrEqual:
+  case FilterType::LessOrEqual: {
+    PostingList rest;
+    if (!directory.findRange(filter.equalityMatch, filter.type, list, rest)) {
+      break;
+    }
+
+    // Only the smaller side is sorted, a wide range is the complement of
+    // the rest among the entries with a value
+    if (list.size() <= rest.size()) {
+      result.sure = fromValueOrder(list);
+      break;
+    }
+
+    PostingList missing;
+    directory.findEqual({filter.equalityMatch.type, std::string_view()},
+                        missing);
+    result.sure = universe -
+                  Bitmap::fromSorted(missing.begin(), missing.end()) -
+                  fromValueOrder(rest);
+    break;
+  }
+  case FilterType::SubstringMatch: {
+    if (directory.findPrefix(filter.substringMatch, list)) {
+      result.sure = fromValueOrder(list);
+      break;
+    }
+
+    std::vector<uint32_t> candidates;
+    if (directory.findSubstringCandidates(filter.substringMatch,
+                                          candidates)) {
+      result.maybe = Bitmap::fromSorted(candidates.data(),
+                                        candidates.data() + candidates.size());
+    } else {
+      result.maybe = universe;
+    }
+    break;
+  }
+  default:
+    break;
+  }
+
+  return result;
+}
+
+FilterPlan FilterPlanner::planAND(const ArenaArray<Filter> &filters) const {
+  if (filters.empty()) {
+    return {universe, {}};
+  }
+
+  // Possible matches of every child, the smallest are intersected first
+  std::vector<FilterPlan> plans;
+  std::vector<Bitmap> possible;
+  for (const auto &filter : filters) {
+    plans.push_back(plan(filter));
+    possible.push_back(plans.back().sure | plans.back().maybe);
+  }
+
+  std::vector<size_t> order(filters.size());
+  std::vector<size_t> sizes(filters.size());
+  for (size_t i = 0; i < filters.size(); ++i) {
+    order[i] = i;
+    sizes[i] = possible[i].cardinality();
+  }
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return sizes[a] < sizes[b]; });
+
+  Bitmap sure = plans[order[0]].sure;
+  Bitmap possibleAll = possible[order[0]];
+  for (size_t i = 1; i < order.size() && !possibleAll.empty(); ++i) {
+    sure = sure & plans[order[i]].sure;
+    possibleAll = possibleAll & possible[order[i]];
+  }
+
+  return {sure, possibleAll - sure};
+}
+
+FilterPlan FilterPlanner::planOR(const ArenaArray<Filter> &filters) const {
+  FilterPlan result;
+  Bitmap possible;
+
+  for (const auto &filter : filters) {
+    FilterPlan nested = plan(filter);
+    result.sure = result.sure | nested.sure;
+    possible = possible | nested.sure | nested.maybe;
+  }
+
+  result.maybe = possible - result.sure;
+  return result;
+}
+
+FilterPlan FilterPlanner::planNOT(const Filter &filter) const {
+  FilterPlan nested = plan(filter);
+
+  // Complement against every entry, sure and possible swap roles
+  Bitmap sure = universe - (nested.sure | nested.maybe);
+  Bitmap maybe = nested.maybe;
+  return {sure, maybe};
+}
@@ -0,0 +1,218 @@
+/**
+ * @file program.cpp
+ * @brief This file contains the FilterProgram class implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include "../include/kernels.h"
+#include "../include/program.h"
+
+void FilterProgram::compile(const Filter &filter) {
+  code.clear();
+  values.clear();
+  substrings.clear();
+  anyParts.clear();
+  text.clear();
+
+  compileNode(filter);
+}
+
+Pattern FilterProgram::addText(std::string_view str) {
+  Pattern pattern = {static_cast<uint32_t>(text.size()),
+                     static_cast<uint32_t>(str.size())};
+  text += str;
+  return pattern;
+}
+
+// Unknown attributes resolve to ATTRIBUTE_COUNT
+static uint8_t resolveAttribute(std::string_view name) {
+  Attribute attribute;
+  if (!getAttributeType(name, attribute)) {
+    return ATTRIBUTE_COUNT;
+  }
+  return static_cast<uint8_t>(attribute);
+}
+
+void FilterProgram::compileNode(const Filter &filter) {
+  switch (filter.type) {
+  case FilterType::Present: {
+    uint8_t attribute = resolveAttribute(filter.present);
+
+    // Every entry is an object, other unknown attributes are never present
+    if (attribute == ATTRIBUTE_COUNT) {
+      code.push_back({isObjectClass(filter.present) ? OpCode::True
+                                                    : OpCode::False,
+                      0, 0});
+      break;
+    }
+
+    code.push_back({OpCode::Present, attribute, 0});
+    break;
+  }
+  case FilterType::EqualityMatch:
+  case FilterType::GreaterOrEqual:
+  case FilterType::LessOrEqual:
+  case FilterType::ApproxMatch: {
+    uint8_t attribute = resolveAttribute(filter.equalityMatch.type);
+
+    // Assertions on an unknown attribute never match
+    if (attribute == ATTRIBUTE_COUNT) {
+      code.push_back({OpCode::False, 0, 0});
+      break;
+    }
+
+    // The attributes define no approximate rule, it is an equality match
+    OpCode op = OpCode::Equal;
+    if (filter.type == FilterType::GreaterOrEqual) {
+      op = OpCode::GreaterOrEqual;
+    } else if (filter.type == FilterType::LessOrEqual) {
+      op = OpCode::LessOrEqual;
+    }
+
+    values.push_back(addText(filter.equalityMatch.value));
+    code.push_back({op, attribute, static_cast<uint32_t>(values.size() - 1)});
+    break;
+  }
+  case FilterType::SubstringMatch: {
+    const SubsType &subs = filter.substringMatch;
+
+    SubstringPattern pattern;
+    pattern.initial = addText(subs.initial);
+    pattern.final = addText(subs.final);
+    pattern.firstAny = anyParts.size();
+    pattern.anyCount = subs.any.size();
+    for (const auto &part : subs.any) {
+      anyParts.push_back(addText(part));
+    }
+
+    substrings.push_back(pattern);
+    code.push_back({OpCode::Substring, resolveAttribute(subs.type),
+                    static_cast<uint32_t>(substrings.size() - 1)});
+    break;
+  }
+  case FilterType::AND:
+  case FilterType::OR: {
+    if (filter.filters.empty()) {
+      code.push_back(
+          {filter.type == FilterType::AND ? OpCode::True : OpCode::False, 0,
+           0});
+      break;
+    }
+
+    // Jump to the end as soon as a child decides the result
+    OpCode jump = filter.type == FilterType::AND ? OpCode::JumpIfFalse
+                                                 : OpCode::JumpIfTrue;
+    std::vector<size_t> jumps;
+    for (size_t i = 0; i < filter.filters.size(); ++i) {
+      compileNode(filter.filters[i]);
+      if (i + 1 < filter.filters.size()) {
+        jumps.push_back(code.size());
+        code.push_back({jump, 0, 0});
+      }
+    }
+
+    for (size_t jumpPos : jumps) {
+      code[jumpPos].operand = code.size();
+    }
+    break;
+  }
+  case FilterType::NOT:
+    if (filter.filters.size() != 1) {
+      code.push_back({OpCode::False, 0, 0});
+      break;
+    }
+    compileNode(filter.filters[0]);
+    code.push_back({OpCode::Not, 0, 0});
+    break;
+  default:
+    code.push_back({OpCode::False, 0, 0});
+    break;
+  }
+}
+
+// Filters are folded, so they are matched against the folded values,
+// substring on an unknown attribute matches against an empty value
+static std::string_view getValue(const EntryTable &entries, uint8_t attribute,
+                                 uint32_t id) {
+  if (attribute >= ATTRIBUTE_COUNT) {
+    return std::string_view();
+  }
+  return entries.folded[attribute].get(id);
+}
+
+bool FilterProgram::matchSubstring(std::string_view value,
+                                   const SubstringPattern &pattern) const {
+  std::string_view initial = getText(pattern.initial);
+  std::string_view final = getText(pattern.final);
+  // Fixed length compares first, they are the cheapest checks
+  if (!startsWithBytes(value, initial) || !endsWithBytes(value, final)) {
+    return false;
+  }
+
+  // Check any parts in sequence
+  size_t startPos = initial.size();
+  for (uint32_t i = 0; i < pattern.anyCount; ++i) {
+    std::string_view part = getText(anyParts[pattern.firstAny + i]);
+    size_t anyPos = findBytes(value, part, startPos);
+    if (anyPos == std::string_view::npos) {
+      return false;
+    }
+    startPos = anyPos + part.size();
+  }
+
+  return true;
+}
+
+bool FilterProgram::matches(const EntryTable &entries, uint32_t id) const {
+  bool result = true;
+  size_t pc = 0;
+
+  while (pc < code.size()) {
+    const Instruction &instruction = code[pc++];
+
+    switch (instruction.op) {
+    case OpCode::True:
+      result = true;
+      break;
+    case OpCode::False:
+      result = false;
+      break;
+    case OpCode::Equal:
+      result = equalBytes(getValue(entries, instruction.attribute, id),
+                          getText(values[instruction.operand]));
+      break;
+    case OpCode::GreaterOrEqual: {
+      // Entries with an empty value have none to order
+      std::string_view value = getValue(entries, instruction.attribute, id);
+      result = !value.empty() && value >= getText(values[instruction.operand]);
+      break;
+    }
+    case OpCode::LessOrEqual: {
+      std::string_view value = getValue(entries, instruction.attribute, id);
+      result = !value.empty() && value <= getText(values[instruction.operand]);
+      break;
+    }
+    case OpCode::Present:
+      result = !getValue(entries, instruction.attribute, id).empty();
+      break;
+    case OpCode::Substring:
+      result = matchSubstring(getValue(entries, instruction.attribute, id),
+                              substrings[instruction.operand]);
+      break;
+    case OpCode::Not:
+      result = !result;
+      break;
+    case OpCode::JumpIfFalse:
+      if (!result) {
+        pc = instruction.operand;
+      }
+      break;
+    case OpCode::JumpIfTrue:
+      if (result) {
+        pc = instruction.operand;
+      }
+      break;
+    }
+  }
+
+  return result;
+}
@@ -5,138 +5,279 @@
  * @author Simon Bencik <xbenci01>
  */
 #include <algorithm>
-#include <fstream>
-#include <iostream>
-#include <sstream>
+#include <array>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "../include/kernels.h"
 #include "../include/search.h"
 
-std::vector<FileEntry> readCSV(const std::string &filename) {
-  std::vector<FileEntry> entries;
-  std::ifstream file(filename);
-  std::string line;
+// Smallest part of the file worth parsing on its own thread
+#define MIN_CHUNK_SIZE (1 << 20)
 
-  while (std::getline(file, line)) {
-    std::stringstream ss(line);
-    std::string cn, uid, mail;
-    std::getline(ss, cn, ';');
-    std::getline(ss, uid, ';');
-    std::getline(ss, mail, ';');
+/**
+ * @struct ParsedColumn
+ * @brief Values of one attribute parsed from a part of the file
+ */
+struct ParsedColumn {
+  std::vector<uint64_t> offsets;
+  std::vector<uint32_t> lengths;
+  uint64_t size = 0;
+};
+
+/**
+ * @brief Values of every attribute parsed from a part of the file
+ */
+typedef std::array<ParsedColumn, ATTRIBUTE_COUNT> ParsedChunk;
+
+/**
+ * @brief Split the lines between begin and end into entries
+ * @param data The contents of the CSV file
+ * @param begin Start of the first line
+ * @param end End of the last line
+ * @param chunk The values to append the entries to
+ */
+static void parseChunk(const char *data, const char *begin, const char *end,
+                       ParsedChunk &chunk) {
+  const char *line = begin;
+
+  while (line < end) {
+    const char *lineEnd =
+        static_cast<const char *>(memchr(line, '\n', end - line));
+    const char *next = lineEnd == nullptr ? end : lineEnd + 1;
+    if (lineEnd == nullptr) {
+      lineEnd = end;
+    }
 
     // Change crlf to lf
-    cn.erase(std::remove(cn.begin(), cn.end(), '\r'), cn.end());
-    uid.erase(std::remove(uid.begin(), uid.end(), '\r'), uid.end());
-    mail.erase(std::remove(mail.begin(), mail.end(), '\r'), mail.end());
+    if (lineEnd > line && lineEnd[-1] == '\r') {
+      --lineEnd;
+    }
 
-    entries.push_back({cn, uid, mail});
-  }
+    // Split the first three fields, missing fields are empty
+    const char *field = line;
+    for (auto &column : chunk) {
+      const char *fieldEnd = field;
+      if (field < lineEnd) {
+        fieldEnd =
+            static_cast<const char *>(memchr(field, ';', lineEnd - field));
+        if (fieldEnd == nullptr) {
+          fieldEnd = lineEnd;
+        }
+      }
 
-  return entries;
+      column.offsets.push_back(field - data);
+      column.lengths.push_back(fieldEnd - field);
+      column.size += fieldEnd - field;
+      field = fieldEnd < lineEnd ? fieldEnd + 1 : lineEnd;
+    }
+
+    line = next;
+  }
 }
 
-bool filterEntry(const Filter &filter, const FileEntry &entry) {
-  switch (filter.type) {
-  case FilterType::ALL:
-    return true;
-  case FilterType::EqualityMatch:
-    return applyEqualityMatch(filter.equalityMatch, entry);
-  case FilterType::SubstringMatch:
-    return applySubstringMatch(filter.substringMatch, entry);
-  case FilterType::AND:
-    return applyAND(filter.filters, entry);
-  case FilterType::OR:
-    return applyOR(filter.filters, entry);
-  case FilterType::NOT:
-    if (filter.filters.size() != 1) {
-      std::cerr << "Expected 1 filter for NOT, got " << filter.filters.size()
-                << std::endl;
-      return {};
+/**
+ * @brief Copy the values parsed from a part of the file into the arenas of
+ * the columns, the offsets then point into the arenas
+ * @param data The contents of the CSV file
+ * @param chunk The values parsed from the part
+ * @param values The arena of every attribute
+ * @param bases Where the values of the part start in every arena
+ */
+static void packChunk(const char *data, ParsedChunk &chunk,
+                      std::array<std::vector<char>, ATTRIBUTE_COUNT> &values,
+                      const std::array<uint64_t, ATTRIBUTE_COUNT> &bases) {
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    ParsedColumn &column = chunk[i];
+    uint64_t offset = bases[i];
+    for (size_t j = 0; j < column.offsets.size(); ++j) {
+      memcpy(values[i].data() + offset, data + column.offsets[j],
+             column.lengths[j]);
+      column.offsets[j] = offset;
+      offset += column.lengths[j];
     }
-    return applyNOT(filter.filters[0], entry);
-  default:
-    return false;
   }
 }
 
-bool applyEqualityMatch(const EqType &eqMatch, const FileEntry &entry) {
-  if (eqMatch.type == "cn") {
-    return entry.cn == eqMatch.value;
-  } else if (eqMatch.type == "uid") {
-    return entry.uid == eqMatch.value;
-  } else if (eqMatch.type == "mail") {
-    return entry.mail == eqMatch.value;
+/**
+ * @brief Run a task for every chunk, each one on its own thread unless there
+ * is only one
+ * @param count The number of chunks
+ * @param task The task, called with the index of the chunk
+ */
+static void forEachChunk(size_t count,
+                         const std::function<void(size_t)> &task) {
+  if (count == 1) {
+    task(0);
+    return;
   }
 
-  return false;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < count; ++i) {
+    workers.emplace_back(task, i);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
 }
 
-bool applySubstringMatch(const SubsType &subsMatch, const FileEntry &entry) {
-  std::string entryValue;
-  // Determine what attribute we are matching on
-  if (subsMatch.type == "cn") {
-    entryValue = entry.cn;
-  } else if (subsMatch.type == "uid") {
-    entryValue = entry.uid;
-  } else if (subsMatch.type == "mail") {
-    entryValue = entry.mail;
-  }
+void readCSV(const char *data, size_t size, EntryTable &table,
+             size_t threads) {
+  const char *end = data + size;
+
+  // Small files are not worth the threads
+  threads = std::max<size_t>(std::min(threads, size / MIN_CHUNK_SIZE), 1);
 
-  if (!subsMatch.initial.empty()) {
-    if (entryValue.find(subsMatch.initial) != 0) {
-      return false;
+  // Chunks of roughly equal size, each one ends after a newline
+  std::vector<const char *> bounds = {data};
+  for (size_t i = 1; i < threads; ++i) {
+    const char *bound = std::max(data + size / threads * i, bounds.back());
+    if (bound > data && bound < end && bound[-1] != '\n') {
+      bound = static_cast<const char *>(memchr(bound, '\n', end - bound));
+      bound = bound == nullptr ? end : bound + 1;
     }
+    bounds.push_back(bound);
   }
+  bounds.push_back(end);
 
-  // Check any parts in sequence
-  size_t startPos =
-      subsMatch.initial.empty()
-          ? 0
-          : entryValue.find(subsMatch.initial) + subsMatch.initial.size();
-  for (const auto &part : subsMatch.any) {
-    size_t anyPos = entryValue.find(part, startPos);
-    if (anyPos == std::string::npos) {
-      return false;
+  std::vector<ParsedChunk> chunks(threads);
+  forEachChunk(threads, [&](size_t chunk) {
+    parseChunk(data, bounds[chunk], bounds[chunk + 1], chunks[chunk]);
+  });
+
+  // The values of an attribute are kept one after another instead of
+  // between the other fields of the line, every chunk copies its values
+  // right after those of the previous one
+  std::array<std::vector<char>, ATTRIBUTE_COUNT> values;
+  std::vector<std::array<uint64_t, ATTRIBUTE_COUNT>> bases(threads);
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    uint64_t total = 0;
+    for (size_t chunk = 0; chunk < threads; ++chunk) {
+      bases[chunk][i] = total;
+      total += chunks[chunk][i].size;
     }
-    startPos = anyPos + part.size();
+    values[i].resize(total);
   }
+  forEachChunk(threads, [&](size_t chunk) {
+    packChunk(data, chunks[chunk], values, bases[chunk]);
+  });
 
-  if (!subsMatch.final.empty()) {
-    size_t finalPos = entryValue.rfind(subsMatch.final);
-    if (finalPos == std::string::npos ||
-        finalPos != entryValue.length() - subsMatch.final.length()) {
-      return false;
+  // Merge in file order so the ids follow the lines
+  for (size_t i = 0; i < ATTRIBUTE_COUNT; ++i) {
+    ParsedColumn column = std::move(chunks[0][i]);
+    for (size_t chunk = 1; chunk < threads; ++chunk) {
+      const ParsedColumn &next = chunks[chunk][i];
+      column.offsets.insert(column.offsets.end(), next.offsets.begin(),
+                            next.offsets.end());
+      column.lengths.insert(column.lengths.end(), next.lengths.begin(),
+                            next.lengths.end());
     }
-  }
 
-  return true;
+    table.columns[i].assign(std::move(values[i]), std::move(column.offsets),
+                            std::move(column.lengths));
+  }
 }
 
-bool applyAND(const std::vector<Filter> &filters, const FileEntry &entry) {
-  for (const auto &filter : filters) {
-    if (!filterEntry(filter, entry)) {
-      return false;
-    }
+bool getAttributeType(std::string_view name, Attribute &attribute) {
+  if (name == "cn") {
+    attribute = Attribute::CN;
+  } else if (name == "uid") {
+    attribute = Attribute::UID;
+  } else if (name == "mail") {
+    attribute = Attribute::MAIL;
+  } else {
+    return false;
   }
 
   return true;
 }
 
-bool applyOR(const std::vector<Filter> &filters, const FileEntry &entry) {
-  for (const auto &filter : filters) {
-    if (filterEntry(filter, entry)) {
-      return true;
+/**
+ * @brief Replace a string of the filter with its folded copy in the arena
+ * @param value The string to fold
+ * @param arena The arena to allocate the copy in
+ */
+static void foldString(std::string_view &value, Arena &arena) {
+  ArenaArray<char> folded = arena.allocate<char>(value.size());
+  foldBytes(value.data(), folded.begin(), value.size());
+  value = std::string_view(folded.begin(), folded.size());
+}
+
+void foldFilter(Filter &filter, Arena &arena) {
+  switch (filter.type) {
+  case FilterType::EqualityMatch:
+  case FilterType::GreaterOrEqual:
+  case FilterType::LessOrEqual:
+  case FilterType::ApproxMatch:
+    foldString(filter.equalityMatch.type, arena);
+    foldString(filter.equalityMatch.value, arena);
+    break;
+  case FilterType::Present:
+    foldString(filter.present, arena);
+    break;
+  case FilterType::SubstringMatch:
+    foldString(filter.substringMatch.type, arena);
+    foldString(filter.substringMatch.initial, arena);
+    for (auto &part : filter.substringMatch.any) {
+      foldString(part, arena);
+    }
+    foldString(filter.substringMatch.final, arena);
+    break;
+  case FilterType::AND:
+  case FilterType::OR:
+  case FilterType::NOT:
+    for (auto &nested : filter.filters) {
+      foldFilter(nested, arena);
     }
+    break;
+  default:
+    break;
   }
+}
 
-  return false;
+void Column::assign(std::vector<char> &&values,
+                    std::vector<uint64_t> &&offsets,
+                    std::vector<uint32_t> &&lengths) {
+  this->values = Array<char>(std::move(values));
+  this->offsets = Array<uint64_t>(std::move(offsets));
+  this->lengths = Array<uint32_t>(std::move(lengths));
 }
 
-bool applyNOT(const Filter &filter, const FileEntry &entry) {
-  if (filterEntry(filter, entry)) {
-    return false;
+void Column::fold(const Column &column) {
+  // Value by value, an incomplete character never reaches into the next one
+  std::vector<char> lower(column.values.size());
+  for (size_t id = 0; id < column.size(); ++id) {
+    foldBytes(column.values.data() + column.offsets[id],
+              lower.data() + column.offsets[id], column.lengths[id]);
   }
 
-  return true;
+  values = Array<char>(std::move(lower));
+  offsets = Array<uint64_t>::view(column.offsets.data(), column.size());
+  lengths = Array<uint32_t>::view(column.lengths.data(), column.size());
+}
+
+void Column::save(SnapshotWriter &writer) const {
+  writer.add(values);
+  writer.add(offsets);
+  writer.add(lengths);
+}
+
+bool Column::load(SnapshotReader &reader) {
+  return reader.read(values) && reader.read(offsets) && reader.read(lengths) &&
+         offsets.size() == lengths.size();
+}
+
+void Column::saveFolded(SnapshotWriter &writer) const { writer.add(values); }
+
+bool Column::loadFolded(const Column &column, SnapshotReader &reader) {
+  offsets = Array<uint64_t>::view(column.offsets.data(), column.size());
+  lengths = Array<uint32_t>::view(column.lengths.data(), column.size());
+  return reader.read(values) && values.size() == column.values.size();
+}
+
+size_t Column::memoryUsage() const {
+  return values.memoryUsage() + offsets.memoryUsage() + lengths.memoryUsage();
 }
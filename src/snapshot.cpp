@@ -0,0 +1,120 @@
+/**
+ * @file snapshot.cpp
+ * @brief This file contains the binary directory snapshot implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "../include/snapshot.h"
+
+static uint64_t alignOffset(uint64_t offset) {
+  return (offset + SNAPSHOT_ALIGNMENT - 1) & ~uint64_t(SNAPSHOT_ALIGNMENT - 1);
+}
+
+bool isSnapshot(const char *data, size_t size) {
+  return size >= SNAPSHOT_MAGIC_SIZE &&
+         memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) == 0;
+}
+
+bool SnapshotWriter::write(const std::string &filename, uint32_t attributes,
+                           uint64_t entries) const {
+  SnapshotHeader header = {};
+  memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+  header.version = SNAPSHOT_VERSION;
+  header.attributes = attributes;
+  header.entries = entries;
+  header.sections = parts.size();
+
+  // Lay the sections out after the header and the section table
+  std::vector<SnapshotSection> sections(parts.size());
+  uint64_t offset = sizeof(header) + sections.size() * sizeof(SnapshotSection);
+  for (size_t i = 0; i < parts.size(); ++i) {
+    offset = alignOffset(offset);
+    sections[i].offset = offset;
+    sections[i].size = parts[i].size;
+    offset += parts[i].size;
+  }
+
+  // Write next to the target and rename, readers never see a partial file
+  std::string temporary = filename + ".tmp";
+  std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Error: Failed to create snapshot " << temporary
+              << std::endl;
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(sections.data()),
+             sections.size() * sizeof(SnapshotSection));
+
+  const char padding[SNAPSHOT_ALIGNMENT] = {};
+  uint64_t written = sizeof(header) + sections.size() * sizeof(SnapshotSection);
+  for (size_t i = 0; i < parts.size(); ++i) {
+    file.write(padding, sections[i].offset - written);
+    file.write(static_cast<const char *>(parts[i].data), parts[i].size);
+    written = sections[i].offset + parts[i].size;
+  }
+
+  file.close();
+  if (!file) {
+    std::cerr << "Error: Failed to write snapshot " << temporary << std::endl;
+    std::remove(temporary.c_str());
+    return false;
+  }
+
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+    std::cerr << "Error: Failed to replace snapshot " << filename << std::endl;
+    std::remove(temporary.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool SnapshotReader::open(const char *data, size_t size) {
+  if (size < sizeof(SnapshotHeader) || !isSnapshot(data, size)) {
+    return false;
+  }
+
+  SnapshotHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (header.version != SNAPSHOT_VERSION) {
+    std::cerr << "Error: Snapshot version " << header.version
+              << " is not supported" << std::endl;
+    return false;
+  }
+
+  if (header.sections >
+      (size - sizeof(header)) / sizeof(SnapshotSection)) {
+    return false;
+  }
+
+  this->data = data;
+  length = size;
+  sections = reinterpret_cast<const SnapshotSection *>(data + sizeof(header));
+  sectionCount = header.sections;
+  current = 0;
+  attributeCount = header.attributes;
+  entryCount = header.entries;
+  return true;
+}
+
+bool SnapshotReader::next(const char *&section, size_t &sectionSize,
+                          size_t alignment) {
+  if (current >= sectionCount) {
+    return false;
+  }
+
+  const SnapshotSection &entry = sections[current++];
+  if (entry.offset > length || entry.size > length - entry.offset) {
+    return false;
+  }
+
+  section = data + entry.offset;
+  sectionSize = entry.size;
+  return reinterpret_cast<uintptr_t>(section) % alignment == 0;
+}
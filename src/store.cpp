@@ -0,0 +1,162 @@
+/**
+ * @file store.cpp
+ * @brief This file contains the DirectoryStore and DirectoryWatcher classes
+ * implementation
+ * @author Simon Bencik <xbenci01>
+ */
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "../include/store.h"
+
+// Time without further changes before the file is reloaded, in ms
+#define RELOAD_DELAY 200
+
+DirectoryReader::DirectoryReader(DirectoryReader &&other) noexcept
+    : store(other.store), shard(other.shard), parity(other.parity),
+      directory(other.directory) {
+  other.store = nullptr;
+}
+
+DirectoryReader::~DirectoryReader() {
+  if (store != nullptr) {
+    store->shards[shard].readers[parity].fetch_sub(1);
+  }
+}
+
+DirectoryStore::DirectoryStore(std::unique_ptr<Directory> directory)
+    : owner(std::move(directory)), current(owner.get()) {
+  for (auto &shard : shards) {
+    shard.readers[0] = 0;
+    shard.readers[1] = 0;
+  }
+}
+
+DirectoryStore::~DirectoryStore() {}
+
+DirectoryReader DirectoryStore::acquire() const {
+  // Every thread sticks to one shard
+  static std::atomic<size_t> nextShard{0};
+  thread_local size_t shard = nextShard.fetch_add(1) % READER_SHARDS;
+
+  // Count the reader before loading the pointer, a publisher which does not
+  // see the count swapped the pointer before it was loaded
+  size_t parity = epoch.load() & 1;
+  shards[shard].readers[parity].fetch_add(1);
+
+  return DirectoryReader(this, shard, parity, current.load());
+}
+
+void DirectoryStore::publish(std::unique_ptr<Directory> directory) {
+  std::lock_guard<std::mutex> lock(publishMutex);
+
+  // Stamped before it is visible, so searches never pair it with another
+  // version number
+  std::shared_ptr<Directory> next(std::move(directory));
+  next->setVersion(published.load() + 1);
+  current.store(next.get());
+  published.fetch_add(1);
+
+  // A reader may have read the epoch before the previous flip, so wait for
+  // the readers of both parities, each one after flipping away from it
+  for (int flip = 0; flip < 2; ++flip) {
+    size_t parity = epoch.fetch_add(1) & 1;
+    for (auto &shard : shards) {
+      while (shard.readers[parity].load() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  // Freed here unless responses still pointing into it share the ownership
+  owner = std::move(next);
+}
+
+bool DirectoryWatcher::start() {
+  // Watch the folder for a new file renamed over the watched one, writes in
+  // place are ignored, the old file is mapped by searches in progress
+  std::string folder = ".";
+  name = filename;
+  size_t slash = filename.rfind('/');
+  if (slash != std::string::npos) {
+    folder = slash == 0 ? "/" : filename.substr(0, slash);
+    name = filename.substr(slash + 1);
+  }
+
+  inotifyFd = inotify_init1(IN_CLOEXEC);
+  if (inotifyFd == -1) {
+    std::cerr << "Error: Failed to create inotify instance" << std::endl;
+    return false;
+  }
+
+  if (inotify_add_watch(inotifyFd, folder.c_str(),
+                        IN_MOVED_TO) == -1) {
+    std::cerr << "Error: Failed to watch " << folder << std::endl;
+    close(inotifyFd);
+    inotifyFd = -1;
+    return false;
+  }
+
+  std::thread(&DirectoryWatcher::watch, this).detach();
+  return true;
+}
+
+void DirectoryWatcher::watch() {
+  alignas(inotify_event) char buffer[4096];
+
+  while (true) {
+    ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      std::cerr << "Error: Failed to read inotify events" << std::endl;
+      return;
+    }
+
+    bool changed = false;
+    for (char *position = buffer; position < buffer + length;) {
+      const inotify_event *event =
+          reinterpret_cast<const inotify_event *>(position);
+      if (event->len > 0 && name == event->name) {
+        changed = true;
+      }
+      position += sizeof(inotify_event) + event->len;
+    }
+
+    if (!changed) {
+      continue;
+    }
+
+    // Let a burst of writes settle before loading
+    pollfd pending = {inotifyFd, POLLIN, 0};
+    while (poll(&pending, 1, RELOAD_DELAY) > 0) {
+      if (read(inotifyFd, buffer, sizeof(buffer)) <= 0) {
+        break;
+      }
+    }
+
+    reload();
+  }
+}
+
+void DirectoryWatcher::reload() {
+  auto loadStart = std::chrono::steady_clock::now();
+
+  auto directory = std::make_unique<Directory>();
+  if (!directory->load(filename, threads)) {
+    std::cerr << "Error: Failed to reload " << filename
+              << ", keeping the loaded entries" << std::endl;
+    return;
+  }
+
+  size_t entries = directory->size();
+  store.publish(std::move(directory));
+
+  auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - loadStart);
+  std::cout << "Reloaded " << entries << " entries from " << filename
+            << " in " << loadTime.count() << " ms" << std::endl;
+}